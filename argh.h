@@ -1,12 +1,83 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
+#if defined(ARGH_ENABLE_STATS)
+#  include <chrono>
+#  include <functional>
+#endif
+
+// C++17 fast path: std::from_chars, std::string_view interop and transparent lookups.
+// Selected by the language standard, define ARGH_NO_CPP17 to keep the C++11 code.
+#if defined(_MSVC_LANG) && _MSVC_LANG > __cplusplus
+#  define ARGH_CPLUSPLUS _MSVC_LANG
+#else
+#  define ARGH_CPLUSPLUS __cplusplus
+#endif
+#if !defined(ARGH_NO_CPP17) && ARGH_CPLUSPLUS >= 201703L && defined(__has_include)
+#  if __has_include(<charconv>) && __has_include(<string_view>)
+#     include <charconv>
+#     include <optional>
+#     include <string_view>
+#     define ARGH_CPP17
+#  endif
+#endif
+// C++17 relaxes constexpr enough to render the help text of a constexpr schema at compile time
+#if defined(ARGH_CPP17)
+#  define ARGH_CPP17_CONSTEXPR constexpr
+#else
+#  define ARGH_CPP17_CONSTEXPR inline
+#endif
+// floating point std::from_chars came later than the integer overloads
+#if defined(ARGH_CPP17) && defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#  define ARGH_CPP17_FLOAT_CHARCONV
+#endif
+
+// SIMD scanning of the args, define ARGH_NO_SIMD for the scalar code only
+#if !defined(ARGH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  define ARGH_SSE2
+#elif !defined(ARGH_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#  include <arm_neon.h>
+#  define ARGH_NEON
+#endif
+#if (defined(ARGH_SSE2) || defined(ARGH_NEON)) && defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+// memory-mapped files (see mapped_file), define ARGH_ENABLE_MAPPED_FILES for the platform calls.
+// Without it the files are read into memory, and no platform header is included. <windows.h> is included
+// as it is: define NOMINMAX or WIN32_LEAN_AND_MEAN first if wanted, argh.h calls (std::min) either way.
+#if defined(ARGH_ENABLE_MAPPED_FILES) && defined(_WIN32)
+#  include <windows.h>
+#elif defined(ARGH_ENABLE_MAPPED_FILES)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
 namespace argh
 {
@@ -17,7 +88,7 @@ namespace argh
    //    2.1: Flags: boolean options =>  (exist ? true : false)
    //    2.2: Parameters: a name followed by a non-option value
 
-#if !defined(__GNUC__) || (__GNUC__ >= 5)
+#if !defined(__GNUC__) || (__GNUC__ >= 5) || defined(ARGH_CPP17)
    using string_stream = std::istringstream;
 #else
     // Until GCC 5, istringstream did not have a move constructor.
@@ -68,365 +139,4012 @@ namespace argh
    using string_stream = stringstream_proxy;
 #endif
 
-   class parser
+   // A minimal non-owning view of a character range, used by view_parser to
+   // slice names, values and positional args straight out of the borrowed argv.
+   class string_view
    {
    public:
-      enum Mode { PREFER_FLAG_FOR_UNREG_OPTION = 1 << 0,
-                  PREFER_PARAM_FOR_UNREG_OPTION = 1 << 1,
-                  NO_SPLIT_ON_EQUALSIGN = 1 << 2,
-                  SINGLE_DASH_IS_MULTIFLAG = 1 << 3,
-                };
-
-      parser() = default;
-
-      parser(std::initializer_list<char const* const> pre_reg_names)
-      {  add_params(pre_reg_names); }
+      static const size_t npos = static_cast<size_t>(-1);
 
-      parser(const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
-      {  parse(argv, mode); }
+      string_view() = default;
+      string_view(const char* str) : data_(str), size_(str ? std::char_traits<char>::length(str) : 0) {}
+      string_view(const char* str, size_t len) : data_(str), size_(len) {}
+      template<typename Allocator>
+      string_view(std::basic_string<char, std::char_traits<char>, Allocator> const& str) : data_(str.data()), size_(str.size()) {}
+#if defined(ARGH_CPP17)
+      // implicit from std::string_view, explicit back to it, so mixed comparisons stay unambiguous
+      string_view(std::string_view str) : data_(str.data()), size_(str.size()) {}
+      explicit operator std::string_view() const { return std::string_view(data_, size_); }
+#endif
 
-      parser(int argc, const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
-      {  parse(argc, argv, mode); }
+      const char* data()  const { return data_; }
+      size_t size()       const { return size_; }
+      size_t length()     const { return size_; }
+      bool empty()        const { return 0 == size_; }
+      const char* begin() const { return data_; }
+      const char* end()   const { return data_ + size_; }
+      char operator[](size_t pos) const { return data_[pos]; }
+      char back()         const { return data_[size_ - 1]; }
 
-      void add_param(std::string const& name);
-      void add_params(std::initializer_list<char const* const> init_list);
+      string_view substr(size_t pos, size_t count = npos) const
+      {
+         assert(pos <= size_);
+         return string_view(data_ + pos, (std::min)(count, size_ - pos));
+      }
 
-      void parse(const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
-      void parse(int argc, const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+      size_t find(char c, size_t pos = 0) const
+      {
+         for (; pos < size_; ++pos)
+            if (c == data_[pos])
+               return pos;
+         return npos;
+      }
 
-      std::multiset<std::string>          const& flags()    const { return flags_;    }
-      std::map<std::string, std::string>  const& params()   const { return params_;   }
-      std::vector<std::string>            const& pos_args() const { return pos_args_; }
+      size_t find_first_not_of(char c, size_t pos = 0) const
+      {
+         for (; pos < size_; ++pos)
+            if (c != data_[pos])
+               return pos;
+         return npos;
+      }
 
-      // begin() and end() for using range-for over positional args.
-      std::vector<std::string>::const_iterator begin() const { return pos_args_.cbegin(); }
-      std::vector<std::string>::const_iterator end()   const { return pos_args_.cend();   }
-      size_t size()                                    const { return pos_args_.size();   }
+      int compare(string_view other) const
+      {
+         auto res = size_ && other.size_ ? std::char_traits<char>::compare(data_, other.data_, (std::min)(size_, other.size_)) : 0;
+         if (0 != res)
+            return res;
+         return size_ == other.size_ ? 0 : (size_ < other.size_ ? -1 : 1);
+      }
 
-      //////////////////////////////////////////////////////////////////////////
-      // Accessors
+      explicit operator std::string() const { return std::string(data_, size_); }
 
-      // flag (boolean) accessors: return true if the flag appeared, otherwise false.
-      bool operator[](std::string const& name) const;
+   private:
+      const char* data_ = nullptr;
+      size_t size_ = 0;
+   };
 
-      // multiple flag (boolean) accessors: return true if at least one of the flag appeared, otherwise false.
-      bool operator[](std::initializer_list<char const* const> init_list) const;
+   inline bool operator==(string_view lhs, string_view rhs) { return 0 == lhs.compare(rhs); }
+   inline bool operator!=(string_view lhs, string_view rhs) { return 0 != lhs.compare(rhs); }
+   inline bool operator< (string_view lhs, string_view rhs) { return lhs.compare(rhs) < 0;  }
 
-      // returns positional arg string by order. Like argv[] but without the options
-      std::string const& operator[](size_t ind) const;
+   inline std::ostream& operator<<(std::ostream& os, string_view str)
+   {
+      return os.write(str.data(), static_cast<std::streamsize>(str.size()));
+   }
 
-      // returns a std::istream that can be used to convert a positional arg to a typed value.
-      string_stream operator()(size_t ind) const;
+   // Get an std::string out of either storage type without copying an std::string.
+   inline std::string const& as_std_string(std::string const& str) { return str; }
+   inline std::string as_std_string(string_view str) { return std::string(str); }
 
-      // same as above, but with a default value in case the arg is missing (index out of range).
-      template<typename T>
-      string_stream operator()(size_t ind, T&& def_val) const;
+   template<typename Allocator>
+   std::string as_std_string(std::basic_string<char, std::char_traits<char>, Allocator> const& str) { return std::string(str.data(), str.size()); }
 
-      // parameter accessors, give a name get an std::istream that can be used to convert to a typed value.
-      // call .str() on result to get as string
-      string_stream operator()(std::string const& name) const;
+   //////////////////////////////////////////////////////////////////////////
+   // Allocation-free typed conversion, used by get<T>().
 
-      // accessor for a parameter with multiple names, give a list of names, get an std::istream that can be used to convert to a typed value.
-      // call .str() on result to get as string
-      // returns the first value in the list to be found.
-      string_stream operator()(std::initializer_list<char const* const> init_list) const;
+   // A minimal optional value. Empty when the arg is missing or could not be converted.
+   template<typename T>
+   class optional
+   {
+   public:
+      optional() = default;
+      optional(T const& value) : value_(value), has_value_(true) {}
 
-      // same as above, but with a default value in case the param was missing.
-      // Non-string def_val types must have an operator<<() (output stream operator)
-      // If T only has an input stream operator, pass the string version of the type as in "3" instead of 3.
-      template<typename T>
-      string_stream operator()(std::string const& name, T&& def_val) const;
+      bool has_value()            const { return has_value_; }
+      explicit operator bool()    const { return has_value_; }
+      T const& operator*()        const { assert(has_value_); return value_; }
+      T const* operator->()       const { assert(has_value_); return &value_; }
+      T const& value()            const { assert(has_value_); return value_; }
 
-      // same as above but for a list of names. returns the first value to be found.
-      template<typename T>
-      string_stream operator()(std::initializer_list<char const* const> init_list, T&& def_val) const;
+      template<typename U>
+      T value_or(U&& def_val)     const { return has_value_ ? value_ : static_cast<T>(std::forward<U>(def_val)); }
 
-   private:
-      string_stream bad_stream() const;
-      std::string trim_leading_dashes(std::string const& name) const;
-      bool is_number(std::string const& arg) const;
-      bool is_option(std::string const& arg) const;
-      bool got_flag(std::string const& name) const;
-      bool is_param(std::string const& name) const;
+#if defined(ARGH_CPP17)
+      operator std::optional<T>() const { return has_value_ ? std::optional<T>(value_) : std::nullopt; }
+#endif
 
    private:
-      std::vector<std::string> args_;
-      std::map<std::string, std::string> params_;
-      std::vector<std::string> pos_args_;
-      std::multiset<std::string> flags_;
-      std::set<std::string> registeredParams_;
-      std::string empty_;
+      T value_{};
+      bool has_value_ = false;
    };
 
+   // Each from_chars() overload converts the whole of [first, last) or fails.
+   // Unlike operator>>, there are no partial reads ("12abc" is not 12), no whitespace skipping and no allocation.
+   template<typename T>
+   typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, bool>::type
+   from_chars(const char* first, const char* last, T& value)
+   {
+      bool negative = false;
+      if (first != last && ('-' == *first || '+' == *first))
+      {
+         negative = '-' == *first;
+         ++first;
+      }
+      if (first == last || (negative && !std::is_signed<T>::value))
+         return false;
 
-   //////////////////////////////////////////////////////////////////////////
+      // accumulate as unsigned to detect overflow before it happens
+      using U = typename std::make_unsigned<T>::type;
+      U const limit = negative ? static_cast<U>(static_cast<U>(-((std::numeric_limits<T>::min)() + 1)) + 1u)
+                               : static_cast<U>((std::numeric_limits<T>::max)());
+      U acc = 0;
+      for (; first != last; ++first)
+      {
+         unsigned digit = static_cast<unsigned char>(*first) - '0';
+         if (digit > 9 || acc > (limit - digit) / 10)
+            return false;
+         acc = static_cast<U>(acc * 10 + digit);
+      }
+      value = negative ? static_cast<T>(0 - acc) : static_cast<T>(acc);
+      return true;
+   }
 
-   inline void parser::parse(const char * const argv[], int mode)
+   template<typename T>
+   typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+   from_chars(const char* first, const char* last, T& value)
    {
-      int argc = 0;
-      for (auto argvp = argv; *argvp; ++argc, ++argvp);
-      parse(argc, argv, mode);
+      size_t const len = static_cast<size_t>(last - first);
+      if (0 == len || std::isspace(static_cast<unsigned char>(*first)))
+         return false;
+#if defined(ARGH_CPP17_FLOAT_CHARCONV)
+      // no copy and no locale in the common case, strto*() still takes '+', hex and out of range values
+      if ('+' != *first)
+      {
+         T parsed{};
+         auto const res = std::from_chars(first, last, parsed);
+         if (std::errc() == res.ec && last == res.ptr)
+         {
+            value = parsed;
+            return true;
+         }
+      }
+#endif
+      // strto*() need a terminated string, short values are copied to the stack instead of allocating.
+      // they also read the locale's decimal point, so '.' is swapped for it and the locale's own is not accepted.
+      char stack[128];
+      std::string heap;
+      char* buf = stack;
+      if (len >= sizeof(stack))
+      {
+         heap.assign(len + 1, '\0');
+         buf = &heap[0];
+      }
+      auto const locale_point = std::localeconv()->decimal_point;
+      char const point = locale_point && *locale_point ? *locale_point : '.';
+      for (size_t i = 0; i < len; ++i)
+      {
+         if ('.' != point && point == first[i])
+            return false;
+         buf[i] = '.' == first[i] ? point : first[i];
+      }
+      buf[len] = '\0';
+
+      char* end = nullptr;
+      errno = 0;
+      long double parsed = std::is_same<T, float>::value  ? std::strtof(buf, &end) :
+                           std::is_same<T, double>::value ? std::strtod(buf, &end) :
+                                                            std::strtold(buf, &end);
+      // like operator>>, only an overflow fails: an underflow is the nearest finite value, subnormal or 0
+      if (end != buf + len || (ERANGE == errno && std::isinf(parsed)))
+         return false;
+      value = static_cast<T>(parsed);
+      return true;
    }
 
-   //////////////////////////////////////////////////////////////////////////
+   // bool accepts "1", "0", "true" and "false".
+   inline bool from_chars(const char* first, const char* last, bool& value)
+   {
+      string_view str(first, static_cast<size_t>(last - first));
+      if ("1" == str || "true" == str)  { value = true;  return true; }
+      if ("0" == str || "false" == str) { value = false; return true; }
+      return false;
+   }
 
-   inline void parser::parse(int argc, const char* const argv[], int mode /*= PREFER_FLAG_FOR_UNREG_OPTION*/)
+   // string_view just points at the stored value.
+   inline bool from_chars(const char* first, const char* last, string_view& value)
    {
-      // convert to strings
-      args_.resize(argc);
-      std::transform(argv, argv + argc, args_.begin(), [](const char* const arg) { return arg;  });
+      value = string_view(first, static_cast<size_t>(last - first));
+      return true;
+   }
 
-      // parse line
-      for (auto i = 0u; i < args_.size(); ++i)
-      {
-         if (!is_option(args_[i]))
-         {
-            pos_args_.emplace_back(args_[i]);
-            continue;
-         }
+   inline bool from_chars(const char* first, const char* last, std::string& value)
+   {
+      value.assign(first, last);
+      return true;
+   }
 
-         auto name = trim_leading_dashes(args_[i]);
+#if defined(ARGH_CPP17)
+   inline bool from_chars(const char* first, const char* last, std::string_view& value)
+   {
+      value = std::string_view(first, static_cast<size_t>(last - first));
+      return true;
+   }
+#endif
 
-         if (!(mode & NO_SPLIT_ON_EQUALSIGN))
-         {
-            auto equalPos = name.find('=');
-            if (equalPos != std::string::npos)
-            {
-               params_.insert({ name.substr(0, equalPos), name.substr(equalPos + 1) });
-               continue;
-            }
-         }
+   //////////////////////////////////////////////////////////////////////////
+   // Arena allocation.
+   // monotonic_arena hands out memory from a caller-supplied buffer and never frees individual allocations.
+   // When the buffer is exhausted it falls back to heap blocks, which reset() and the destructor release.
+   // Everything allocated from the arena must be destroyed before reset() is called.
 
-         // if the option is unregistered and should be a multi-flag
-         if (1 == (args_[i].size() - name.size()) &&         // single dash
-            argh::parser::SINGLE_DASH_IS_MULTIFLAG & mode && // multi-flag mode
-            !is_param(name))                                  // unregistered
-         {
-            std::string keep_param; 
-            
-            if (!name.empty() && is_param(std::string(1ul, name.back()))) // last char is param
-            {
-               keep_param += name.back();
-               name.resize(name.size() - 1);
-            }
+   class monotonic_arena
+   {
+   public:
+      monotonic_arena(void* buffer, size_t size) :
+         buffer_(static_cast<char*>(buffer)), size_(size)
+      {}
 
-            for (auto const& c : name)
-            {
-               flags_.emplace(std::string{ c });
-            }
+      monotonic_arena(monotonic_arena const&) = delete;
+      monotonic_arena& operator=(monotonic_arena const&) = delete;
 
-            if (!keep_param.empty())
-            {
-               name = keep_param;
-            }
-            else
-            {
-               continue; // do not consider other options for this arg
-            }
-         }
+      ~monotonic_arena() { release(); }
 
-         // any potential option will get as its value the next arg, unless that arg is an option too
-         // in that case it will be determined a flag.
-         if (i == args_.size() - 1 || is_option(args_[i + 1]))
+      void* allocate(size_t bytes, size_t alignment)
+      {
+         auto const base = reinterpret_cast<std::uintptr_t>(buffer_);
+         auto const aligned = static_cast<size_t>(((base + used_ + alignment - 1) & ~(alignment - 1)) - base);
+         if (aligned + bytes <= size_)
          {
-            flags_.emplace(name);
-            continue;
+            used_ = aligned + bytes;
+            return buffer_ + aligned;
          }
+         // overflow: chain a heap block, the block header keeps the list
+         auto block = static_cast<overflow_block*>(::operator new(sizeof(overflow_block) + bytes + alignment));
+         block->next = overflow_;
+         overflow_ = block;
+         auto const raw = reinterpret_cast<std::uintptr_t>(block + 1);
+         return reinterpret_cast<void*>((raw + alignment - 1) & ~(alignment - 1));
+      }
 
-         // if 'name' is a pre-registered option, then the next arg cannot be a free parameter to it is skipped
-         // otherwise we have 2 modes:
-         // PREFER_FLAG_FOR_UNREG_OPTION: a non-registered 'name' is determined a flag. 
-         //                               The following value (the next arg) will be a free parameter.
-         //
-         // PREFER_PARAM_FOR_UNREG_OPTION: a non-registered 'name' is determined a parameter, the next arg
-         //                                will be the value of that option.
+      // bytes used in the caller-supplied buffer, and whether the buffer overflowed to the heap.
+      size_t used()       const { return used_; }
+      bool overflowed()   const { return nullptr != overflow_; }
 
-         assert(!(mode & argh::parser::PREFER_FLAG_FOR_UNREG_OPTION)
-             || !(mode & argh::parser::PREFER_PARAM_FOR_UNREG_OPTION));
+      // release everything at once and start over at the beginning of the buffer.
+      void reset()
+      {
+         release();
+         used_ = 0;
+      }
 
-         bool preferParam = mode & argh::parser::PREFER_PARAM_FOR_UNREG_OPTION;
+   private:
+      struct overflow_block { overflow_block* next; };
 
-         if (is_param(name) || preferParam)
-         {
-            params_.insert({ name, args_[i + 1] });
-            ++i; // skip next value, it is not a free parameter
-            continue;
-         }
-         else
+      void release()
+      {
+         while (overflow_)
          {
-            flags_.emplace(name);
+            auto next = overflow_->next;
+            ::operator delete(overflow_);
+            overflow_ = next;
          }
-      };
-   }
+      }
 
-   //////////////////////////////////////////////////////////////////////////
+      char* buffer_;
+      size_t size_;
+      size_t used_ = 0;
+      overflow_block* overflow_ = nullptr;
+   };
 
-   inline string_stream parser::bad_stream() const
+   // A stateful allocator drawing from a monotonic_arena. deallocate() is a no-op.
+   // A default-constructed arena_allocator (no arena) uses the global heap.
+   template<typename T>
+   class arena_allocator
    {
-      string_stream bad;
-      bad.setstate(std::ios_base::failbit);
-      return bad;
-   }
-
-   //////////////////////////////////////////////////////////////////////////
+   public:
+      using value_type = T;
 
-   inline bool parser::is_number(std::string const& arg) const
-   {
-      // inefficient but simple way to determine if a string is a number (which can start with a '-')
-      std::istringstream istr(arg);
-      double number;
-      istr >> number;
-      return !(istr.fail() || istr.bad());
-   }
+      arena_allocator() = default;
+      arena_allocator(monotonic_arena& arena) : arena_(&arena) {}
 
-   //////////////////////////////////////////////////////////////////////////
+      template<typename U>
+      arena_allocator(arena_allocator<U> const& other) : arena_(other.arena()) {}
 
-   inline bool parser::is_option(std::string const& arg) const
-   {
-      assert(0 != arg.size());
-      if (is_number(arg))
-         return false;
-      return '-' == arg[0];
-   }
+      T* allocate(size_t n)
+      {
+         if (!arena_)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+         return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+      }
 
-   //////////////////////////////////////////////////////////////////////////
+      void deallocate(T* ptr, size_t)
+      {
+         if (!arena_)
+            ::operator delete(ptr);
+      }
 
-   inline std::string parser::trim_leading_dashes(std::string const& name) const
-   {
-      auto pos = name.find_first_not_of('-');
-      return std::string::npos != pos ? name.substr(pos) : name;
-   }
+      monotonic_arena* arena() const { return arena_; }
 
-   //////////////////////////////////////////////////////////////////////////
+   private:
+      monotonic_arena* arena_ = nullptr;
+   };
 
-   inline bool argh::parser::got_flag(std::string const& name) const
-   {
-      return flags_.end() != flags_.find(trim_leading_dashes(name));
-   }
+   template<typename T, typename U>
+   bool operator==(arena_allocator<T> const& a, arena_allocator<U> const& b) { return a.arena() == b.arena(); }
 
-   //////////////////////////////////////////////////////////////////////////
+   template<typename T, typename U>
+   bool operator!=(arena_allocator<T> const& a, arena_allocator<U> const& b) { return a.arena() != b.arena(); }
 
-   inline bool argh::parser::is_param(std::string const& name) const
-   {
-      return registeredParams_.count(name);
-   }
+   using arena_string = std::basic_string<char, std::char_traits<char>, arena_allocator<char>>;
 
-   //////////////////////////////////////////////////////////////////////////
+   template<typename Allocator, typename T>
+   using rebind_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
 
-   inline bool parser::operator[](std::string const& name) const
+   // Build a String from a view, using alloc if String is allocator-aware (string_view is not).
+   template<typename String, typename Allocator>
+   typename std::enable_if<std::uses_allocator<String, Allocator>::value, String>::type
+   make_string(string_view str, Allocator const& alloc)
    {
-      return got_flag(name);
+      return String(str.data(), str.size(), typename String::allocator_type(alloc));
    }
 
-   //////////////////////////////////////////////////////////////////////////
-
-   inline bool parser::operator[](std::initializer_list<char const* const> init_list) const
+   template<typename String, typename Allocator>
+   typename std::enable_if<!std::uses_allocator<String, Allocator>::value, String>::type
+   make_string(string_view str, Allocator const&)
    {
-      return std::any_of(init_list.begin(), init_list.end(), [&](char const* const name) { return got_flag(name); });
+      return String(str.data(), str.size());
    }
 
    //////////////////////////////////////////////////////////////////////////
+   // Flat containers: sorted contiguous vectors used by flat_storage.
+   // Insertions are appended and the container is sorted once by finalize(), which the parser calls
+   // after it is done inserting. Lookups are only valid on a finalized container.
+   // Iteration is in key order, like the node-based std containers they replace.
 
-   inline std::string const& parser::operator[](size_t ind) const
+   template<typename Key, typename Allocator = std::allocator<Key>>
+   class flat_multiset
    {
-      if (ind < pos_args_.size())
-         return pos_args_[ind];
-      return empty_;
-   }
+   public:
+      using value_type     = Key;
+      using const_iterator = typename std::vector<Key, Allocator>::const_iterator;
+      using iterator       = const_iterator;
 
-   //////////////////////////////////////////////////////////////////////////
+      flat_multiset() = default;
+      explicit flat_multiset(Allocator const& alloc) : keys_(alloc) {}
 
-   inline string_stream parser::operator()(std::string const& name) const
-   {
-      auto optIt = params_.find(trim_leading_dashes(name));
-      if (params_.end() != optIt)
-         return string_stream(optIt->second);
-      return bad_stream();
-   }
+      const_iterator begin() const { return keys_.cbegin(); }
+      const_iterator end()   const { return keys_.cend();   }
+      size_t size()          const { return keys_.size();   }
+      bool empty()           const { return keys_.empty();  }
 
-   //////////////////////////////////////////////////////////////////////////
+      template<typename... Args>
+      void emplace(Args&&... args) { keys_.emplace_back(std::forward<Args>(args)...); }
+      void insert(Key const& key)  { keys_.push_back(key); }
 
-   inline string_stream parser::operator()(std::initializer_list<char const* const> init_list) const
-   {
-      for (auto& name : init_list)
+      // find() and count() accept any key type comparable with Key, e.g. a string_view for std::string keys.
+      template<typename K>
+      const_iterator find(K const& key) const
       {
-         auto optIt = params_.find(trim_leading_dashes(name));
-         if (params_.end() != optIt)
-            return string_stream(optIt->second);
+         auto it = std::lower_bound(keys_.cbegin(), keys_.cend(), key);
+         return (it != keys_.cend() && !(key < *it)) ? it : keys_.cend();
       }
-      return bad_stream();
-   }
-
-   //////////////////////////////////////////////////////////////////////////
-
-   template<typename T>
-   string_stream parser::operator()(std::string const& name, T&& def_val) const
-   {
-      auto optIt = params_.find(trim_leading_dashes(name));
-      if (params_.end() != optIt)
-         return string_stream(optIt->second);
 
-      std::ostringstream ostr;
-      ostr << def_val;
-      return string_stream(ostr.str()); // use default
-   }
+      template<typename K>
+      size_t count(K const& key) const
+      {
+         auto range = std::equal_range(keys_.cbegin(), keys_.cend(), key);
+         return static_cast<size_t>(range.second - range.first);
+      }
 
-   //////////////////////////////////////////////////////////////////////////
+      void finalize() { std::sort(keys_.begin(), keys_.end()); }
 
-   // same as above but for a list of names. returns the first value to be found.
-   template<typename T>
-   string_stream parser::operator()(std::initializer_list<char const* const> init_list, T&& def_val) const
-   {
-      for (auto& name : init_list)
-      {
-         auto optIt = params_.find(trim_leading_dashes(name));
-         if (params_.end() != optIt)
-            return string_stream(optIt->second);
-      }      
-      std::ostringstream ostr;
-      ostr << def_val;
-      return string_stream(ostr.str()); // use default
-   }
+      // drops all keys, keeps the capacity.
+      void clear() { keys_.clear(); }
 
-   //////////////////////////////////////////////////////////////////////////
+   protected:
+      std::vector<Key, Allocator> keys_;
+   };
 
-   inline string_stream parser::operator()(size_t ind) const
+   // flat_set drops duplicate keys on finalize().
+   template<typename Key, typename Allocator = std::allocator<Key>>
+   class flat_set : public flat_multiset<Key, Allocator>
    {
-      if (pos_args_.size() <= ind)
-         return bad_stream();
+   public:
+      using flat_multiset<Key, Allocator>::flat_multiset;
 
-      return string_stream(pos_args_[ind]);
-   }
+      void finalize()
+      {
+         flat_multiset<Key, Allocator>::finalize();
+         this->keys_.erase(std::unique(this->keys_.begin(), this->keys_.end()), this->keys_.end());
+      }
 
-   //////////////////////////////////////////////////////////////////////////
+      // insert a missing key at its sorted position, so a finalized set stays finalized without a sort.
+      void insert_sorted(Key&& key)
+      {
+         auto it = std::lower_bound(this->keys_.begin(), this->keys_.end(), key);
+         if (this->keys_.end() == it || key < *it)
+            this->keys_.insert(it, std::move(key));
+      }
+   };
 
-   template<typename T>
-   string_stream parser::operator()(size_t ind, T&& def_val) const
+   namespace flat_detail
    {
-      if (pos_args_.size() <= ind)
+      // Merges the sorted [first, middle) and [middle, last) by rotations, stable and without memory.
+      template<typename It, typename Less>
+      void merge_in_place(It first, It middle, It last, Less less)
       {
-         std::ostringstream ostr;
-         ostr << def_val;
-         return string_stream(ostr.str());
+         if (first == middle || middle == last)
+            return;
+         if (2 == last - first)
+         {
+            if (less(*middle, *first))
+               std::iter_swap(first, middle);
+            return;
+         }
+         It cut1, cut2;
+         if (middle - first > last - middle)
+         {
+            cut1 = first + (middle - first) / 2;
+            cut2 = std::lower_bound(middle, last, *cut1, less);
+         }
+         else
+         {
+            cut2 = middle + (last - middle) / 2;
+            cut1 = std::upper_bound(first, middle, *cut2, less);
+         }
+         auto const new_middle = std::rotate(cut1, middle, cut2);
+         merge_in_place(first, cut1, new_middle, less);
+         merge_in_place(new_middle, cut2, last, less);
       }
 
-      return string_stream(pos_args_[ind]);
+      // Like std::stable_sort, but in place: O(n log^2 n) moves, and no temporary buffer is allocated.
+      template<typename It, typename Less>
+      void stable_sort_in_place(It first, It last, Less less)
+      {
+         if (last - first <= 16)
+         {
+            for (auto it = first; it != last; ++it) // insertion sort
+               for (auto k = it; k != first && less(*k, *(k - 1)); --k)
+                  std::iter_swap(k, k - 1);
+            return;
+         }
+         auto const middle = first + (last - first) / 2;
+         stable_sort_in_place(first, middle, less);
+         stable_sort_in_place(middle, last, less);
+         merge_in_place(first, middle, last, less);
+      }
    }
 
-   //////////////////////////////////////////////////////////////////////////
-
-   inline void parser::add_param(std::string const& name)
+   // flat_map keeps the *first* inserted value of a duplicate key on finalize(), like std::map::insert().
+   template<typename Key, typename Value, typename Allocator = std::allocator<std::pair<Key, Value>>>
+   class flat_map
    {
-      registeredParams_.insert(trim_leading_dashes(name));
-   }
+   public:
+      using value_type     = std::pair<Key, Value>;
+      using const_iterator = typename std::vector<value_type, Allocator>::const_iterator;
+      using iterator       = const_iterator;
 
-   //////////////////////////////////////////////////////////////////////////
+      flat_map() = default;
+      explicit flat_map(Allocator const& alloc) : entries_(alloc) {}
 
-   inline void parser::add_params(std::initializer_list<char const* const> init_list)
-   {
-      for (auto& name : init_list)
-         registeredParams_.insert(trim_leading_dashes(name));
-   }
-}
+      const_iterator begin() const { return entries_.cbegin(); }
+      const_iterator end()   const { return entries_.cend();   }
+      size_t size()          const { return entries_.size();   }
+      bool empty()           const { return entries_.empty();  }
 
+      void insert(value_type const& entry) { entries_.push_back(entry); }
+      void insert(value_type&& entry)      { entries_.push_back(std::move(entry)); }
 
+      // insert an entry with a missing key at its sorted position, so a finalized map stays finalized without a sort.
+      void insert_sorted(value_type&& entry)
+      {
+         auto it = std::lower_bound(entries_.begin(), entries_.end(), entry, key_less());
+         if (entries_.end() == it || entry.first < it->first)
+            entries_.insert(it, std::move(entry));
+      }
+
+      // drops all entries, keeps the capacity.
+      void clear() { entries_.clear(); }
+
+      // find(), count() and at() accept any key type comparable with Key, e.g. a string_view for std::string keys.
+      template<typename K>
+      const_iterator find(K const& key) const
+      {
+         auto it = std::lower_bound(entries_.cbegin(), entries_.cend(), key, key_less());
+         return (it != entries_.cend() && !(key < it->first)) ? it : entries_.cend();
+      }
+
+      template<typename K>
+      size_t count(K const& key) const { return end() != find(key) ? 1 : 0; }
+
+      template<typename K>
+      Value const& at(K const& key) const
+      {
+         auto it = find(key);
+         assert(end() != it);
+         return it->second;
+      }
+
+      void finalize()
+      {
+         auto const not_increasing = [](value_type const& a, value_type const& b) { return !(a.first < b.first); };
+         if (entries_.end() == std::adjacent_find(entries_.begin(), entries_.end(), not_increasing))
+            return; // already sorted, no duplicates
+
+         // sort by key, ties by insertion order, then keep the first of each key. Both in place, so a
+         // steady-state reparse() does not allocate however the params arrive.
+         flat_detail::stable_sort_in_place(entries_.begin(), entries_.end(), key_less());
+         entries_.erase(std::unique(entries_.begin(), entries_.end(),
+                                    [](value_type const& a, value_type const& b) { return !(a.first < b.first); }),
+                        entries_.end());
+      }
+
+   private:
+      struct key_less
+      {
+         bool operator()(value_type const& a, value_type const& b) const { return a.first < b.first; }
+         template<typename K>
+         bool operator()(value_type const& a, K const& b)          const { return a.first < b; }
+      };
+
+      std::vector<value_type, Allocator> entries_;
+   };
+
+   // alias names to the first name of their param or flag, shared so views of the names survive copies
+   using alias_map = flat_map<std::string, std::shared_ptr<std::string const>>;
+
+   // the first name of an alias, or name itself
+   inline string_view resolve_alias(alias_map const& aliases, string_view name)
+   {
+      if (aliases.empty())
+         return name;
+      auto it = aliases.find(name);
+      return aliases.end() != it ? string_view(*it->second) : name;
+   }
+
+   // flat_counter counts the occurrences of each key: add() appends, finalize() sorts and merges the repeats.
+   template<typename Key, typename Allocator = std::allocator<std::pair<Key, std::uint32_t>>>
+   class flat_counter
+   {
+   public:
+      using value_type     = std::pair<Key, std::uint32_t>;
+      using const_iterator = typename std::vector<value_type, Allocator>::const_iterator;
+
+      flat_counter() = default;
+      explicit flat_counter(Allocator const& alloc) : entries_(alloc) {}
+
+      const_iterator begin() const { return entries_.cbegin(); }
+      const_iterator end()   const { return entries_.cend();   }
+      bool empty()           const { return entries_.empty();  }
+
+      void add(Key&& key) { entries_.emplace_back(std::move(key), 1u); }
+
+      // accepts any key type comparable with Key, 0 if the key is missing.
+      template<typename K>
+      std::uint32_t count(K const& key) const
+      {
+         auto it = std::lower_bound(entries_.cbegin(), entries_.cend(), key, [](value_type const& a, K const& b) { return a.first < b; });
+         return (it != entries_.cend() && !(key < it->first)) ? it->second : 0;
+      }
+
+      void finalize()
+      {
+         std::sort(entries_.begin(), entries_.end(), [](value_type const& a, value_type const& b) { return a.first < b.first; });
+         auto out = entries_.begin();
+         for (auto it = entries_.begin(); it != entries_.end(); ++it)
+         {
+            if (out != it && out->first == it->first)
+               out->second += it->second;
+            else if (out != it && ++out != it)
+               *out = std::move(*it);
+         }
+         if (!entries_.empty())
+            entries_.erase(out + 1, entries_.end());
+      }
+
+      // drops all entries, keeps the capacity.
+      void clear() { entries_.clear(); }
+
+   private:
+      std::vector<value_type, Allocator> entries_;
+   };
+
+   // An input iterator over a table of strings accessed by index as string_views. It keeps the current view,
+   // so `for (auto& arg : strings)` works.
+   template<typename Table>
+   class indexed_iterator
+   {
+   public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type        = string_view;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = string_view const*;
+      using reference         = string_view const&;
+
+      indexed_iterator() = default;
+      indexed_iterator(Table const* strings, size_t ind) : strings_(strings), ind_(ind) { load(); }
+
+      reference operator*()  const { return current_; }
+      pointer   operator->() const { return &current_; }
+
+      indexed_iterator& operator++()   { ++ind_; load(); return *this; }
+      indexed_iterator  operator++(int) { auto prev = *this; ++*this; return prev; }
+
+      bool operator==(indexed_iterator const& other) const { return ind_ == other.ind_; }
+      bool operator!=(indexed_iterator const& other) const { return ind_ != other.ind_; }
+
+   private:
+      void load() { if (strings_ && ind_ < strings_->size()) current_ = (*strings_)[ind_]; }
+
+      Table const* strings_ = nullptr;
+      size_t ind_ = 0;
+      string_view current_;
+   };
+
+   // packed_strings stores strings back to back in one char buffer (each NUL-terminated) with an offset array,
+   // one allocation per growth instead of one per string. Elements are accessed as string_views into the
+   // buffer, valid until the next push_back() or clear().
+   template<typename Allocator = std::allocator<char>>
+   class packed_strings
+   {
+   public:
+      using value_type      = string_view;
+      using reference       = string_view;
+      using const_reference = string_view;
+      using size_type       = size_t;
+      using allocator_type  = Allocator;
+
+      using const_iterator  = indexed_iterator<packed_strings>;
+      using iterator        = const_iterator;
+
+      packed_strings() = default;
+      explicit packed_strings(Allocator const& alloc) : chars_(alloc), ends_(alloc) {}
+
+      void push_back(string_view str)
+      {
+         chars_.insert(chars_.end(), str.begin(), str.end());
+         ends_.push_back(chars_.size());
+         chars_.push_back('\0');
+      }
+
+      // reserve room for count strings of chars chars in total
+      void reserve(size_t count, size_t chars) { ends_.reserve(count); chars_.reserve(chars + count); }
+
+      string_view operator[](size_t ind) const
+      {
+         auto const first = ind ? ends_[ind - 1] + 1 : 0;
+         return string_view(chars_.data() + first, ends_[ind] - first);
+      }
+
+      const_iterator begin()  const { return const_iterator(this, 0); }
+      const_iterator end()    const { return const_iterator(this, size()); }
+      const_iterator cbegin() const { return begin(); }
+      const_iterator cend()   const { return end(); }
+
+      size_t size()  const { return ends_.size(); }
+      bool   empty() const { return ends_.empty(); }
+      void   clear()       { chars_.clear(); ends_.clear(); } // keeps the capacity
+
+   private:
+      std::vector<char, Allocator> chars_;
+      std::vector<size_t, rebind_alloc<Allocator, size_t>> ends_; // one past the last char of each string
+   };
+
+   // Storage policies for basic_parser.
+   // tree_storage: std::multiset/std::map/std::set, one node per entry. The default.
+   // flat_storage: sorted contiguous vectors, fewer allocations and cache-friendly lookups.
+   // packed_storage: flat_storage with all positional args packed into one buffer (see packed_strings).
+   // The containers draw their memory from (a rebound copy of) Allocator.
+   struct tree_storage
+   {
+      template<typename String, typename Allocator = std::allocator<String>>
+      using vector = std::vector<String, rebind_alloc<Allocator, String>>;
+
+      template<typename Key, typename Allocator = std::allocator<Key>>
+      using multiset = std::multiset<Key, std::less<Key>, rebind_alloc<Allocator, Key>>;
+
+      template<typename Key, typename Value, typename Allocator = std::allocator<Key>>
+      using map = std::map<Key, Value, std::less<Key>, rebind_alloc<Allocator, std::pair<Key const, Value>>>;
+
+      template<typename Key, typename Allocator = std::allocator<Key>>
+      using set = std::set<Key, std::less<Key>, rebind_alloc<Allocator, Key>>;
+
+      // a node per distinct key, not per occurrence
+      template<typename Key, typename Allocator = std::allocator<Key>>
+      class counter
+      {
+      public:
+         using value_type     = std::pair<Key const, std::uint32_t>;
+         using const_iterator = typename std::map<Key, std::uint32_t, std::less<Key>, rebind_alloc<Allocator, value_type>>::const_iterator;
+
+         counter() = default;
+         explicit counter(Allocator const& alloc) : counts_(alloc) {}
+
+         const_iterator begin() const { return counts_.cbegin(); }
+         const_iterator end()   const { return counts_.cend();   }
+         bool empty()           const { return counts_.empty();  }
+
+         void add(Key&& key) { ++counts_[std::move(key)]; }
+
+         std::uint32_t count(string_view key) const
+         {
+            auto it = counts_.find(lookup_key(key, static_cast<Key*>(nullptr)));
+            return counts_.end() != it ? it->second : 0;
+         }
+
+         void finalize() {}
+         void clear() { counts_.clear(); }
+
+      private:
+         std::map<Key, std::uint32_t, std::less<Key>, rebind_alloc<Allocator, value_type>> counts_;
+      };
+
+      template<typename Container>
+      static void finalize(Container&) {}
+
+      template<typename Container>
+      static typename Container::const_iterator find(Container const& container, string_view key)
+      {
+         return container.find(lookup_key(key, static_cast<typename Container::key_type*>(nullptr)));
+      }
+
+      // std::less<Key> has no heterogeneous lookup, so the key is materialized. A std::string key is
+      // assigned to a per-thread buffer, so long names reuse its capacity instead of allocating.
+      // The container types stay the same in every language standard.
+      static std::string const& lookup_key(string_view key, std::string*)
+      {
+         static thread_local std::string buffer;
+         buffer.assign(key.data(), key.size());
+         return buffer;
+      }
+
+      template<typename Key>
+      static Key lookup_key(string_view key, Key*) { return Key(key.data(), key.size()); }
+   };
+
+   struct flat_storage
+   {
+      template<typename String, typename Allocator = std::allocator<String>>
+      using vector = std::vector<String, rebind_alloc<Allocator, String>>;
+
+      template<typename Key, typename Allocator = std::allocator<Key>>
+      using multiset = flat_multiset<Key, rebind_alloc<Allocator, Key>>;
+
+      template<typename Key, typename Value, typename Allocator = std::allocator<Key>>
+      using map = flat_map<Key, Value, rebind_alloc<Allocator, std::pair<Key, Value>>>;
+
+      template<typename Key, typename Allocator = std::allocator<Key>>
+      using set = flat_set<Key, rebind_alloc<Allocator, Key>>;
+
+      template<typename Key, typename Allocator = std::allocator<Key>>
+      using counter = flat_counter<Key, rebind_alloc<Allocator, std::pair<Key, std::uint32_t>>>;
+
+      template<typename Container>
+      static void finalize(Container& container) { container.finalize(); }
+
+      // compares the stored keys with the view in place, no allocation.
+      template<typename Container>
+      static typename Container::const_iterator find(Container const& container, string_view key)
+      {
+         return container.find(key);
+      }
+   };
+
+   struct packed_storage : flat_storage
+   {
+      template<typename String, typename Allocator = std::allocator<String>>
+      using vector = packed_strings<rebind_alloc<Allocator, char>>;
+   };
+
+#if defined(ARGH_ENABLE_STATS)
+   // Parse statistics of a parser, compiled in with ARGH_ENABLE_STATS (see basic_parser::stats()).
+   // parse() adds to them, reset() zeroes them.
+   struct parse_stats
+   {
+      enum event { POSITIONAL, FLAG, PARAM };
+
+      size_t tokens = 0;                // args classified
+      size_t positionals = 0;
+      size_t flags = 0;
+      size_t params = 0;
+      size_t multiflag_expansions = 0;  // flags split from a multi-flag arg
+      size_t equal_splits = 0;          // params split from a name=value arg
+      size_t is_number_calls = 0;
+      size_t insertions = 0;            // into the result containers
+      std::chrono::nanoseconds elapsed{ 0 };
+
+      // if set, called for each classified arg: (event, name or positional arg, param value)
+      std::function<void(event, string_view, string_view)> trace;
+
+      void clear_counters() { auto keep = std::move(trace); *this = parse_stats(); trace = std::move(keep); }
+   };
+
+   namespace stats_detail
+   {
+      // the stats of the parse running on this thread
+      inline parse_stats*& active()
+      {
+         static thread_local parse_stats* stats = nullptr;
+         return stats;
+      }
+   }
+
+   // runs the statements with `argh_stats` pointing to the active parse_stats, if any
+#  define ARGH_STATS(...) do { if (auto argh_stats = ::argh::stats_detail::active()) { __VA_ARGS__; } } while (false)
+#else
+#  define ARGH_STATS(...) do {} while (false)
+#endif
+
+   // value_cache memoises values by (key, type). Lookups are lock-free and safe from concurrent readers:
+   // each bucket is a list that only grows at its head (by compare-and-swap), until clear().
+   class value_cache
+   {
+   public:
+      value_cache() { for (auto& bucket : buckets_) bucket.store(nullptr, std::memory_order_relaxed); }
+      value_cache(value_cache const&) : value_cache() {} // copies start empty
+      value_cache& operator=(value_cache const&) { clear(); return *this; }
+      ~value_cache() { clear(); }
+
+      // the value cached for (key, T), computed by make() on first use. Concurrent first uses may
+      // both call make(), one result is kept and the other dropped.
+      template<typename T, typename Make>
+      T const& get(string_view key, Make&& make) const;
+
+      // drop all values, not safe with concurrent readers.
+      void clear();
+
+   private:
+      struct node
+      {
+         node(void const* type_, string_view key_) : type(type_), key(key_.data(), key_.size()) {}
+         virtual ~node() = default;
+
+         void const* type;
+         std::string key;
+         node* next = nullptr;
+      };
+
+      template<typename T>
+      struct typed_node : node
+      {
+         typed_node(string_view key_, T&& value_) : node(type_id<T>(), key_), value(std::move(value_)) {}
+         T value;
+      };
+
+      template<typename T>
+      static void const* type_id() { static char const id = 0; return &id; }
+
+      static node* match(node* first, node* last, void const* type, string_view key)
+      {
+         for (; first != last; first = first->next)
+            if (first->type == type && string_view(first->key) == key)
+               return first;
+         return nullptr;
+      }
+
+      static size_t const bucket_count = 64;
+      mutable std::atomic<node*> buckets_[bucket_count];
+      mutable std::atomic<bool> empty_{ true }; // so clearing an unused cache is free
+
+   };
+
+   // char_flags counts the single char flags, e.g. of -xvzf, in a 256 bit bitmap and a counter per char:
+   // no node per occurrence, O(1) lookups.
+   class char_flags
+   {
+   public:
+      char_flags() = default;
+      char_flags(char_flags const& other) : bits_(other.bits_), size_(other.size_) { copy_counts(other); }
+      char_flags& operator=(char_flags const& other)
+      {
+         bits_ = other.bits_;
+         size_ = other.size_;
+         copy_counts(other);
+         return *this;
+      }
+
+      void add(char c)
+      {
+         auto const u = static_cast<unsigned char>(c);
+         if (test(c))
+         {
+            ++counts_[u];
+         }
+         else
+         {
+            bits_[u >> 6] |= std::uint64_t(1) << (u & 63);
+            counts_[u] = 1;
+         }
+         ++size_;
+      }
+
+      bool test(char c) const
+      {
+         auto const u = static_cast<unsigned char>(c);
+         return 0 != ((bits_[u >> 6] >> (u & 63)) & 1);
+      }
+
+      std::uint32_t count(char c) const { return test(c) ? counts_[static_cast<unsigned char>(c)] : 0; }
+      size_t size() const { return size_; } // occurrences
+      bool empty() const  { return 0 == size_; }
+
+      // f(char, count) for each char that appeared, in std::string order
+      template<typename F>
+      void for_each(F&& f) const
+      {
+         for (size_t word = 0; word < bits_.size(); ++word)
+            for (auto bits = bits_[word]; bits; bits &= bits - 1)
+            {
+               auto const u = static_cast<unsigned char>(word * 64 + lowest_bit(bits));
+               f(static_cast<char>(u), counts_[u]);
+            }
+      }
+
+      void clear()
+      {
+         bits_.fill(0);
+         size_ = 0;
+      }
+
+      // c as a name with static storage, so views of it do not dangle
+      static string_view name(char c)
+      {
+         struct table { char chars[256]; table() { for (int i = 0; i < 256; ++i) chars[i] = static_cast<char>(i); } };
+         static table const names;
+         return string_view(names.chars + static_cast<unsigned char>(c), 1);
+      }
+
+   private:
+      static unsigned lowest_bit(std::uint64_t bits)
+      {
+         unsigned i = 0;
+         for (; !(bits & 1); bits >>= 1)
+            ++i;
+         return i;
+      }
+
+      void copy_counts(char_flags const& other)
+      {
+         other.for_each([this](char c, std::uint32_t count) { counts_[static_cast<unsigned char>(c)] = count; });
+      }
+
+      std::array<std::uint64_t, 4> bits_ = {{}};
+      std::uint32_t counts_[256];  // only set for the chars in bits_, so construction and clear() are cheap
+      size_t size_ = 0;
+   };
+
+   // once_latch runs a lazy initialisation once, safe from concurrent callers, until reset().
+   class once_latch
+   {
+   public:
+      once_latch() = default;
+      once_latch(once_latch const& other) : done_(other.done()) {}
+      once_latch& operator=(once_latch const& other) { done_.store(other.done(), std::memory_order_relaxed); return *this; }
+
+      bool done() const { return done_.load(std::memory_order_acquire); }
+
+      template<typename F>
+      void run(F&& f) const
+      {
+         guard lock(*this);
+         if (!done_.load(std::memory_order_relaxed))
+         {
+            f();
+            finish();
+         }
+      }
+
+      // holds the latch, for an initialisation done in steps. Call finish() under it when complete.
+      struct guard
+      {
+         explicit guard(once_latch const& latch) : latch_(latch)
+         {
+            while (latch_.busy_.exchange(true, std::memory_order_acquire))
+               std::this_thread::yield();
+         }
+         ~guard() { latch_.busy_.store(false, std::memory_order_release); }
+
+         guard(guard const&) = delete;
+         guard& operator=(guard const&) = delete;
+
+      private:
+         once_latch const& latch_;
+      };
+
+      void finish() const { done_.store(true, std::memory_order_release); }
+
+      // not safe with concurrent callers
+      void reset() { done_.store(false, std::memory_order_relaxed); }
+
+   private:
+      mutable std::atomic<bool> done_{ false };
+      mutable std::atomic<bool> busy_{ false };
+   };
+
+   // parser_base holds the parsing modes and the classification rules shared by all parsers.
+   class parser_base
+   {
+   public:
+      enum Mode { PREFER_FLAG_FOR_UNREG_OPTION = 1 << 0,
+                  PREFER_PARAM_FOR_UNREG_OPTION = 1 << 1,
+                  NO_SPLIT_ON_EQUALSIGN = 1 << 2,
+                  SINGLE_DASH_IS_MULTIFLAG = 1 << 3,
+                };
+
+      // a MULTI_VALUE param keeps all its values, see basic_parser::values()
+      enum ParamKind { SINGLE_VALUE, MULTI_VALUE };
+
+      // Classify the args in [first, last) (anything convertible to string_view) and report them to handler:
+      //    bool handler.is_param(string_view name)   - is 'name' a pre-registered parameter?
+      //    void handler.positional(string_view arg)
+      //    void handler.flag(string_view name)
+      //    void handler.param(string_view name, string_view value)
+      //    bool handler.stop() const                 - optional, stop before the next arg once true
+      // All reported views are slices of the input args. Returns the first arg not parsed, last unless stopped.
+      template<typename Iterator, typename Handler>
+      static Iterator parse_args(Iterator first, Iterator last, int mode, Handler& handler);
+
+      static string_view trim_leading_dashes(string_view name);
+      static bool is_number(string_view arg);
+      static bool is_option(string_view arg);
+
+      // The classification of an arg, computed once in one scan:
+      struct arg_info
+      {
+         enum kind_type : std::uint8_t
+         {
+            POSITIONAL,
+            OPTION,        // --name or -name, its kind depends on the next arg
+            SHORT_OPTION,  // single dash -name, a multi-flag in SINGLE_DASH_IS_MULTIFLAG mode
+            ASSIGNMENT,    // --name=value, unless NO_SPLIT_ON_EQUALSIGN
+         };
+
+         kind_type kind;
+         std::uint32_t name;   // offset of the name, as trim_leading_dashes()
+         std::uint32_t equal;  // offset of the '=' in the name of an ASSIGNMENT
+
+         bool option() const { return POSITIONAL != kind; }
+      };
+      static arg_info classify(string_view arg, int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+
+   protected:
+      // Report the flags of the multi-flag 'name' to handler.
+      // Returns true if its last char is left as a registered param 'name', whose value is the next arg.
+      template<typename Handler>
+      static bool split_multiflag(string_view& name, Handler& handler);
+
+      // does the option 'name' take the next arg (which is not an option) as its value?
+      template<typename Handler>
+      static bool takes_value(string_view name, bool registered, int mode, Handler& handler);
+
+      // handler.stop(), or false if the handler has none
+      template<typename Handler>
+      static auto stopped(Handler const& handler, int) -> decltype(handler.stop()) { return handler.stop(); }
+      template<typename Handler>
+      static bool stopped(Handler const&, long) { return false; }
+
+      static string_stream bad_stream();
+
+      template<typename T>
+      static optional<T> convert(string_view str);
+
+   private:
+      // vectorised (SSE2/NEON) where available, with a scalar tail and fallback
+      static size_t find_byte(char const* first, size_t size, char c);       // size if not found
+      static size_t count_leading(char const* first, size_t size, char c);
+   };
+
+   // a private copy of a file, which can be modified in place without touching the file. It is mapped
+   // copy-on-write with ARGH_ENABLE_MAPPED_FILES, so only the modified pages are copied, and read otherwise.
+   class mapped_file
+   {
+   public:
+      explicit mapped_file(char const* path);
+      ~mapped_file();
+
+      mapped_file(mapped_file const&) = delete;
+      mapped_file& operator=(mapped_file const&) = delete;
+
+      bool is_open() const { return open_; }
+      char* data()         { return data_; }
+      size_t size()  const { return size_; }
+
+   private:
+      char* data_ = nullptr;
+      size_t size_ = 0;
+      bool open_ = false;
+      std::vector<char> buffer_; // the read file, without ARGH_ENABLE_MAPPED_FILES
+   };
+
+   //////////////////////////////////////////////////////////////////////////
+   // Option metadata.
+   // An option_spec names a flag or a param and optionally describes it, for a schema (see make_schema())
+   // or for basic_parser::add_option(). The strings are not copied, string literals typically:
+   //
+   //    argh::param("threads", "j").with_type("N").with_default("1").with_help("worker threads")
+   //
+   // help_string() renders the options as a --help table or as a shell completion word list into one buffer:
+   // the text is measured, then written in place. static_help() does the same at compile time (C++17).
+
+   struct option_spec
+   {
+      const char* name;
+      const char* alias;         // "" if none
+      bool        is_param;
+      const char* type;          // the value placeholder in the help table, "VALUE" if ""
+      const char* default_value; // "" if none
+      const char* help;          // "" if none
+
+      constexpr option_spec with_type(const char* text)    const { return { name, alias, is_param, text, default_value, help }; }
+      constexpr option_spec with_default(const char* text) const { return { name, alias, is_param, type, text, help }; }
+      constexpr option_spec with_help(const char* text)    const { return { name, alias, is_param, type, default_value, text }; }
+   };
+
+   constexpr option_spec flag (const char* name, const char* alias = "") { return { name, alias, false, "", "", "" }; }
+   constexpr option_spec param(const char* name, const char* alias = "") { return { name, alias, true,  "", "", "" }; }
+
+   enum help_format
+   {
+      HELP_TEXT,        // "  -j, --threads N  worker threads (default: 1)" per option, aligned
+      COMPLETION_WORDS  // "-j --threads -v --verbose", e.g. for bash's complete -W
+   };
+
+   namespace help_detail
+   {
+      // writes the first limit chars to out and counts them all, so a zero limit only measures
+      struct text_sink
+      {
+         char* out;
+         size_t limit;
+         size_t size;
+
+         ARGH_CPP17_CONSTEXPR void put(char c)
+         {
+            if (size < limit)
+               out[size] = c;
+            ++size;
+         }
+         ARGH_CPP17_CONSTEXPR void put(const char* str)
+         {
+            for (; str && *str; ++str)
+               put(*str);
+         }
+      };
+
+      ARGH_CPP17_CONSTEXPR const char* skip_dashes(const char* str)
+      {
+         while (str && '-' == *str)
+            ++str;
+         return str;
+      }
+
+      ARGH_CPP17_CONSTEXPR size_t length(const char* str)
+      {
+         size_t len = 0;
+         while (str && str[len])
+            ++len;
+         return len;
+      }
+
+      // "-x" for a single char name, "--name" otherwise
+      ARGH_CPP17_CONSTEXPR void put_spelling(text_sink& out, const char* name)
+      {
+         name = skip_dashes(name);
+         out.put(1 == length(name) ? "-" : "--");
+         out.put(name);
+      }
+
+      // the name and alias of an option, the shorter first
+      ARGH_CPP17_CONSTEXPR void put_spellings(text_sink& out, option_spec const& opt, const char* separator)
+      {
+         auto const name_size = length(skip_dashes(opt.name)), alias_size = length(skip_dashes(opt.alias));
+         if (0 == alias_size)
+            return put_spelling(out, opt.name);
+         put_spelling(out, alias_size < name_size ? opt.alias : opt.name);
+         out.put(separator);
+         put_spelling(out, alias_size < name_size ? opt.name : opt.alias);
+      }
+
+      ARGH_CPP17_CONSTEXPR void put_usage(text_sink& out, option_spec const& opt)
+      {
+         out.put("  ");
+         put_spellings(out, opt, ", ");
+         if (opt.is_param)
+         {
+            out.put(' ');
+            out.put(length(opt.type) ? opt.type : "VALUE");
+         }
+      }
+
+      ARGH_CPP17_CONSTEXPR void render(option_spec const* first, option_spec const* last, help_format format, text_sink& out)
+      {
+         if (COMPLETION_WORDS == format)
+         {
+            for (auto it = first; it != last; ++it)
+            {
+               if (it != first)
+                  out.put(' ');
+               put_spellings(out, *it, " ");
+            }
+            if (first != last)
+               out.put('\n');
+            return;
+         }
+
+         size_t width = 0; // of the widest usage column
+         for (auto it = first; it != last; ++it)
+         {
+            text_sink usage{ nullptr, 0, 0 };
+            put_usage(usage, *it);
+            width = usage.size > width ? usage.size : width;
+         }
+         for (auto it = first; it != last; ++it)
+         {
+            auto const start = out.size;
+            put_usage(out, *it);
+            if (length(it->help) || length(it->default_value))
+            {
+               for (auto pad = width + 2 - (out.size - start); pad; --pad)
+                  out.put(' ');
+               out.put(it->help);
+               if (length(it->default_value))
+               {
+                  out.put(length(it->help) ? " (default: " : "(default: ");
+                  out.put(it->default_value);
+                  out.put(')');
+               }
+            }
+            out.put('\n');
+         }
+      }
+   }
+
+   // Render [first, last) into a string sized exactly, with a single allocation.
+   inline std::string help_string(option_spec const* first, option_spec const* last, help_format format = HELP_TEXT)
+   {
+      help_detail::text_sink measure{ nullptr, 0, 0 };
+      help_detail::render(first, last, format, measure);
+      std::string text(measure.size, '\0');
+      help_detail::text_sink out{ &text[0], text.size(), 0 };
+      help_detail::render(first, last, format, out);
+      return text;
+   }
+
+   // Text rendered by static_help(), NUL terminated.
+   template<size_t Size>
+   struct fixed_text
+   {
+      char chars[Size + 1];
+
+      constexpr const char* c_str() const { return chars; }
+      constexpr size_t size()       const { return Size; }
+      operator string_view()        const { return string_view(chars, Size); }
+   };
+
+   // basic_parser is parameterized on the string type used to store the parse results:
+   // - parser (std::string) copies every arg and owns its storage.
+   // - view_parser (argh::string_view) borrows argv and stores non-owning slices into it,
+   //   the argv strings must outlive the parser.
+   // and on the Storage policy used for flags, params and positional args (see tree_storage, flat_storage, packed_storage),
+   // and on the Allocator used for all parse results, e.g. an arena_allocator (see arena_parser).
+   template<typename Parser>
+   class basic_command_parser;
+   template<typename Parser>
+   class basic_lazy_parser;
+
+   template<typename String, typename Storage = tree_storage, typename Allocator = std::allocator<char>>
+   class basic_parser : public parser_base
+   {
+   public:
+      using allocator_type = Allocator;
+      using flag_set       = typename Storage::template multiset<String, Allocator>;
+      using flag_counter   = typename Storage::template counter<String, Allocator>;
+      using param_map      = typename Storage::template map<String, String, Allocator>;
+      using arg_vector     = typename Storage::template vector<String, Allocator>;
+      using name_set       = flat_set<std::string>; // read-only during parse, looked up without allocating
+
+      basic_parser() : basic_parser(allocator_type()) {}
+
+      // all parse results (strings, nodes and vectors) are allocated with alloc.
+      explicit basic_parser(allocator_type const& alloc) :
+         params_(alloc), pos_args_(alloc), flags_(alloc), flagCounts_(alloc), alloc_(alloc), multiValues_(alloc), noValues_(alloc)
+      {}
+
+      basic_parser(std::initializer_list<char const* const> pre_reg_names, allocator_type const& alloc = allocator_type()) :
+         basic_parser(alloc)
+      {  add_params(pre_reg_names); }
+
+      basic_parser(const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION, allocator_type const& alloc = allocator_type()) :
+         basic_parser(alloc)
+      {  parse(argv, mode); }
+
+      basic_parser(int argc, const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION, allocator_type const& alloc = allocator_type()) :
+         basic_parser(alloc)
+      {  parse(argc, argv, mode); }
+
+      void add_param(std::string const& name, ParamKind kind = SINGLE_VALUE);
+
+      // register a param with aliases, e.g. add_param({ "o", "output" }). All its names are stored and looked up
+      // as the first one, so any accessor with any alias finds it.
+      void add_param(std::initializer_list<char const* const> aliases, ParamKind kind = SINGLE_VALUE);
+      void add_params(std::initializer_list<char const* const> init_list);
+
+      // describe an option for help(), registering it like add_param() if it is a param, and linking
+      // the alias of a flag to its name, e.g.
+      // add_option(argh::param("threads", "j").with_type("N").with_help("worker threads")). The strings are not copied.
+      void add_option(option_spec const& spec, ParamKind kind = SINGLE_VALUE);
+
+      // the options of add_option() as a --help table or completion word list, rendered with a single allocation.
+      std::string help(help_format format = HELP_TEXT) const { return help_string(options_.data(), options_.data() + options_.size(), format); }
+
+      // parse() adds to the results of previous calls: positional args are appended and
+      // a param that was already parsed keeps its first value.
+      void parse(const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+      void parse(int argc, const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+
+      // parse the args in [first, last), anything convertible to string_view, e.g. the result of response_files::expand().
+      template<typename Iterator>
+      void parse(Iterator first, Iterator last, int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+
+      // parse args the caller already holds as strings, taking them over instead of copying them:
+      // a parser moves the whole args (positional args and param values) into its results,
+      // a view parser keeps the strings (shared by its copies) and refers to them.
+      void parse(std::vector<std::string>&& args, int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+
+      // Fallback layers for the params missing from the command line, merged into params() by the first parse()
+      // (after a reset()), so a lookup is still one probe: the command line beats the env vars, which beat the config file.
+      // A registered param `output-file` is read from the env var <prefix>OUTPUT_FILE (upper case, '-' as '_').
+      // A view parser refers to the environment, which must not change while it lives.
+      void set_env_prefix(std::string const& prefix);
+
+      // read `key=value` lines from the file at path in one mapped read, '#' starts a comment line.
+      // Returns false if the file cannot be read. Replacing the file after a parse merges the new one by the
+      // next parse(), under the values already merged; a view parser keeps the old file for them.
+      bool set_config_file(char const* path);
+
+      // drop all parse results but keep the pre-registered params, so the parser can be reused.
+      // container capacity is kept where the storage allows it: with flat_storage and string_view
+      // (flat_view_parser) a steady-state reparse() does not allocate.
+      void reset();
+
+      // reset() and parse() a new command line.
+      void reparse(const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+      void reparse(int argc, const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+
+      // all flags, with repeats. The parse counts the flags, they are only stored here on the first call.
+      flag_set   const& flags()    const;
+      param_map  const& params()   const { return params_;   }
+      arg_vector const& pos_args() const { return pos_args_; }
+
+      // the pre-registered param names, e.g. to share with parse_batch()
+      name_set const& registered_params() const { return registeredParams_; }
+
+      // the aliases of params and flags, to their first name
+      alias_map const& aliases() const { return aliases_; }
+
+      allocator_type get_allocator() const { return alloc_; }
+
+      // begin() and end() for using range-for over positional args.
+      typename arg_vector::const_iterator begin() const { return pos_args_.cbegin(); }
+      typename arg_vector::const_iterator end()   const { return pos_args_.cend();   }
+      size_t size()                               const { return pos_args_.size();   }
+
+      //////////////////////////////////////////////////////////////////////////
+      // Accessors
+
+      // flag (boolean) accessors: return true if the flag appeared, otherwise false.
+      bool operator[](string_view name) const;
+
+      // multiple flag (boolean) accessors: return true if at least one of the flag appeared, otherwise false.
+      bool operator[](std::initializer_list<char const* const> init_list) const;
+
+      // how many times the flag appeared, e.g. the verbosity of -v -v -v or -vvv. O(1) for single char flags,
+      // a lookup among the distinct flags for others, without allocating.
+      size_t count(string_view name) const;
+
+      // returns positional arg string by order. Like argv[] but without the options
+      typename arg_vector::const_reference operator[](size_t ind) const;
+
+      // returns a std::istream that can be used to convert a positional arg to a typed value.
+      string_stream operator()(size_t ind) const;
+
+      // same as above, but with a default value in case the arg is missing (index out of range).
+      template<typename T>
+      string_stream operator()(size_t ind, T&& def_val) const;
+
+      // parameter accessors, give a name get an std::istream that can be used to convert to a typed value.
+      // call .str() on result to get as string
+      string_stream operator()(string_view name) const;
+
+      // accessor for a parameter with multiple names, give a list of names, get an std::istream that can be used to convert to a typed value.
+      // call .str() on result to get as string
+      // returns the first value in the list to be found.
+      string_stream operator()(std::initializer_list<char const* const> init_list) const;
+
+      // same as above, but with a default value in case the param was missing.
+      // Non-string def_val types must have an operator<<() (output stream operator)
+      // If T only has an input stream operator, pass the string version of the type as in "3" instead of 3.
+      template<typename T>
+      string_stream operator()(string_view name, T&& def_val) const;
+
+      // same as above but for a list of names. returns the first value to be found.
+      template<typename T>
+      string_stream operator()(std::initializer_list<char const* const> init_list, T&& def_val) const;
+
+      //////////////////////////////////////////////////////////////////////////
+      // Typed accessors: convert with from_chars() instead of building a string_stream.
+      // Supported types are integers, floating point, bool, std::string and string_view.
+      // e.g. auto threads = cmdl.get<int>("threads");  if (threads) use(*threads);
+
+      // returns an empty optional if the positional arg is missing or not convertible to T.
+      template<typename T>
+      optional<T> get(size_t ind) const;
+
+      // same as above, but returns def_val if the arg is missing or not convertible to T.
+      template<typename T, typename U>
+      T get(size_t ind, U&& def_val) const;
+
+      // returns an empty optional if the parameter is missing or not convertible to T.
+      template<typename T>
+      optional<T> get(string_view name) const;
+
+      // same as above but for a list of names. converts the first value to be found.
+      template<typename T>
+      optional<T> get(std::initializer_list<char const* const> init_list) const;
+
+      // same as above, but returns def_val if the param is missing or not convertible to T.
+      template<typename T, typename U>
+      T get(string_view name, U&& def_val) const;
+
+      template<typename T, typename U>
+      T get(std::initializer_list<char const* const> init_list, U&& def_val) const;
+
+      // same as get<T>(name), but the param is only converted on the first call for each name and T,
+      // later calls return the memoised result. Safe to call concurrently on a const parser,
+      // the memoised values are dropped by parse() and reset().
+      template<typename T>
+      optional<T> const& get_cached(string_view name) const;
+
+      template<typename T, typename U>
+      T get_cached(string_view name, U&& def_val) const;
+
+      // all values of a MULTI_VALUE param in command line order, stored contiguously. Empty if the param is
+      // missing or not MULTI_VALUE. The other accessors see its first value.
+      arg_vector const& values(string_view name) const;
+
+   private:
+      bool got_flag(string_view name) const;
+      std::uint32_t flag_count(string_view key) const; // key is canonical
+      bool is_param(string_view name) const;
+      typename param_map::const_iterator find_param(string_view name) const;
+      typename param_map::const_iterator find_param(std::initializer_list<char const* const> init_list) const;
+
+      // the trimmed name, or the first name of its param if it is an alias
+      string_view canonical(string_view name) const;
+
+      // stores the args classified by parse_args()
+      struct handler
+      {
+         basic_parser& self;
+         std::vector<std::string>* source; // if set, the parsed args, whole args are moved out of it
+         size_t next;                      // the first source arg not taken or passed
+
+         bool is_param(string_view name) const           { return self.is_param(name); }
+         void positional(string_view arg)
+         {
+            ARGH_STATS(++argh_stats->positionals; ++argh_stats->insertions; if (argh_stats->trace) argh_stats->trace(parse_stats::POSITIONAL, arg, {}));
+            if (auto str = take(arg))
+               self.push_positional(self.pos_args_, std::move(*str));
+            else
+               self.push_positional(self.pos_args_, arg);
+         }
+         void flag(string_view name)
+         {
+            name = self.canonical(name);
+            ARGH_STATS(++argh_stats->flags; ++argh_stats->insertions; if (argh_stats->trace) argh_stats->trace(parse_stats::FLAG, name, {}));
+            if (1 == name.size())
+               self.charFlags_.add(name[0]);
+            else
+               self.flagCounts_.add(self.store(name));
+            if (self.flagsStored_.done())
+               self.flags_.emplace(self.store(name));
+         }
+         void param(string_view name, string_view value)
+         {
+            name = self.canonical(name);
+            ARGH_STATS(++argh_stats->params; ++argh_stats->insertions; if (argh_stats->trace) argh_stats->trace(parse_stats::PARAM, name, value));
+            if (auto values = self.multi_values(name))
+            {
+               if (values->empty())
+                  self.params_.insert({ self.store(name), self.store(value) });
+               else
+                  ARGH_STATS(--argh_stats->insertions); // only the value list
+               ARGH_STATS(++argh_stats->insertions);
+               if (auto str = take(value))
+                  self.push_positional(*values, std::move(*str));
+               else
+                  self.push_positional(*values, value);
+               return;
+            }
+            if (auto str = take(value))
+               self.params_.insert({ self.store(name), self.store(std::move(*str)) });
+            else
+               self.params_.insert({ self.store(name), self.store(value) });
+         }
+
+         // the source arg `arg` is, if it is a whole one. Events come in source order, so the search
+         // starts at the arg of the previous event.
+         std::string* take(string_view arg)
+         {
+            std::less<char const*> const before;
+            for (auto k = source ? next : 0; source && k < source->size(); ++k)
+            {
+               auto& str = (*source)[k];
+               if (before(arg.data(), str.data()) || before(str.data() + str.size(), arg.data()))
+                  continue;
+               next = k;
+               if (arg.data() != str.data() || arg.size() != str.size())
+                  return nullptr; // a slice, e.g. after '='
+               ++next;
+               return &str;
+            }
+            return nullptr;
+         }
+      };
+
+      arg_vector* multi_values(string_view name);
+
+      // adds the params of the fallback layers, after the command line
+      void merge_layers();
+
+      // makes the containers ready for lookups after parse_args()
+      void finish_parse();
+
+      template<typename Parser>
+      friend class basic_command_parser;
+      template<typename Parser>
+      friend class basic_lazy_parser;
+
+#if defined(ARGH_ENABLE_STATS)
+   public:
+      // counters of the parse() calls since the last reset(), set stats().trace for per-arg events.
+      parse_stats&       stats()       { return stats_; }
+      parse_stats const& stats() const { return stats_; }
+
+   private:
+      // makes stats_ active on this thread for the lifetime of a parse
+      struct stats_scope
+      {
+         explicit stats_scope(parse_stats& stats) : prev(stats_detail::active()), start(std::chrono::steady_clock::now())
+         {
+            stats_detail::active() = &stats;
+         }
+         ~stats_scope()
+         {
+            auto& stats = *stats_detail::active();
+            stats.elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            stats_detail::active() = prev;
+         }
+
+         parse_stats* prev;
+         std::chrono::steady_clock::time_point start;
+      };
+
+      parse_stats stats_;
+#endif
+
+      String store(string_view str) const { return make_string<String>(str, alloc_); }
+
+      // moves str if String is a std::string
+      String store(std::string&& str) const { return store(std::move(str), std::is_same<String, std::string>()); }
+      String store(std::string&& str, std::true_type) const  { return String(std::move(str)); }
+      String store(std::string&& str, std::false_type) const { return store(string_view(str)); }
+
+      template<typename Vector>
+      void push_positional(Vector& args, string_view arg) const { args.push_back(store(arg)); }
+      template<typename Vector>
+      void push_positional(Vector& args, std::string&& arg) const { args.push_back(store(std::move(arg))); }
+      template<typename A>
+      void push_positional(packed_strings<A>& args, string_view arg) const { args.push_back(arg); } // copied into the buffer
+
+   private:
+      param_map params_;
+      arg_vector pos_args_;
+      mutable flag_set flags_; // filled by flags()
+      once_latch flagsStored_;
+      flag_counter flagCounts_;
+      char_flags charFlags_;   // not in flagCounts_
+      name_set registeredParams_;
+      String empty_;
+      allocator_type alloc_;
+      value_cache cache_;
+      name_set multiParams_;
+      std::vector<arg_vector, rebind_alloc<Allocator, arg_vector>> multiValues_; // by index in multiParams_
+      alias_map aliases_;
+      arg_vector noValues_;
+      std::string envPrefix_;
+      bool useEnv_ = false;
+      std::shared_ptr<mapped_file> config_;                              // shared by copies, configEntries_ views into it
+      std::vector<std::pair<string_view, string_view>> configEntries_;   // in file order
+      bool layersMerged_ = false;
+      std::vector<std::shared_ptr<void const>> ownedArgs_;               // the args, layers and config files a view parser refers to
+      std::vector<option_spec> options_;                                       // by add_option(), in order
+   };
+
+   using parser           = basic_parser<std::string>;
+   using view_parser      = basic_parser<string_view>;
+   using flat_parser      = basic_parser<std::string, flat_storage>;
+   using flat_view_parser = basic_parser<string_view, flat_storage>;
+   using packed_parser    = basic_parser<std::string, packed_storage>;
+
+   // parse results allocated from a monotonic_arena, construct with an arena_allocator<char>(arena).
+   using arena_parser      = basic_parser<arena_string, tree_storage, arena_allocator<char>>;
+   using arena_view_parser = basic_parser<string_view, flat_storage, arena_allocator<char>>;
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename T, typename Make>
+   T const& value_cache::get(string_view key, Make&& make) const
+   {
+      auto const type = type_id<T>();
+      size_t hash = 14695981039346656037ull; // FNV-1a
+      for (char c : key)
+         hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+      auto& bucket = buckets_[hash % bucket_count];
+
+      node* head = bucket.load(std::memory_order_acquire);
+      if (auto found = match(head, nullptr, type, key))
+         return static_cast<typed_node<T>*>(found)->value;
+
+      std::unique_ptr<typed_node<T>> fresh(new typed_node<T>(key, make()));
+      for (;;)
+      {
+         fresh->next = head;
+         if (bucket.compare_exchange_weak(head, fresh.get(), std::memory_order_release, std::memory_order_acquire))
+         {
+            empty_.store(false, std::memory_order_relaxed);
+            return fresh.release()->value;
+         }
+         // only the nodes pushed since our last look can hold a racing value
+         if (auto found = match(head, fresh->next, type, key))
+            return static_cast<typed_node<T>*>(found)->value;
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline void value_cache::clear()
+   {
+      if (empty_.exchange(true, std::memory_order_relaxed))
+         return;
+      for (auto& bucket : buckets_)
+      {
+         auto n = bucket.exchange(nullptr, std::memory_order_acquire);
+         while (n)
+         {
+            auto next = n->next;
+            delete n;
+            n = next;
+         }
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Iterator, typename Handler>
+   inline Iterator parser_base::parse_args(Iterator first, Iterator last, int mode, Handler& handler)
+   {
+      // parse line
+      // The args are classified a block at a time into a side table, which the loop below consumes.
+      // The table holds one entry more than the block: the look-ahead of its last arg.
+      static const size_t block = 128;
+      string_view args[block + 1];
+      arg_info infos[block + 1];
+      while (first != last)
+      {
+         size_t count = 0;
+         for (auto it = first; count <= block && it != last; ++it, ++count)
+         {
+            args[count] = *it;
+            infos[count] = classify(args[count], mode);
+         }
+         size_t const end = (std::min)(count, block);
+         ARGH_STATS(argh_stats->tokens += end);
+
+         size_t i = 0;
+         for (; i < end; ++i)
+         {
+            if (stopped(handler, 0))
+            {
+               ARGH_STATS(argh_stats->tokens -= end - i);
+               std::advance(first, i);
+               return first;
+            }
+            auto const& info = infos[i];
+            string_view const arg = args[i];
+            string_view name = arg.substr(info.name);
+            bool registered = false; // known to be a registered param
+            switch (info.kind)
+            {
+            case arg_info::POSITIONAL:
+               handler.positional(arg);
+               continue;
+            case arg_info::ASSIGNMENT:
+               ARGH_STATS(++argh_stats->equal_splits);
+               handler.param(name.substr(0, info.equal), name.substr(info.equal + 1));
+               continue;
+            case arg_info::SHORT_OPTION:
+               if (mode & SINGLE_DASH_IS_MULTIFLAG)
+               {
+                  if (!split_multiflag(name, handler))
+                     continue; // do not consider other options for this arg
+                  registered = true;
+               }
+               break;
+            case arg_info::OPTION:
+               break;
+            }
+
+            // any potential option will get as its value the next arg, unless that arg is an option too
+            // in that case it will be determined a flag.
+            auto const next = i + 1;
+            if (next == count || infos[next].option())
+            {
+               handler.flag(name);
+               continue;
+            }
+
+            if (takes_value(name, registered, mode, handler))
+            {
+               handler.param(name, args[next]);
+               ARGH_STATS(argh_stats->tokens += next == end);
+               i = next; // skip next value, it is not a free parameter (may be the look-ahead entry)
+            }
+            else
+            {
+               handler.flag(name);
+            }
+         }
+         std::advance(first, i);
+      }
+      return first;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Handler>
+   inline bool parser_base::split_multiflag(string_view& name, Handler& handler)
+   {
+      if (handler.is_param(name)) // a registered single dash param, not a multi-flag
+         return true;
+
+      string_view keep_param;
+
+      if (!name.empty() && handler.is_param(name.substr(name.size() - 1))) // last char is param
+      {
+         keep_param = name.substr(name.size() - 1);
+         name = name.substr(0, name.size() - 1);
+      }
+
+      ARGH_STATS(argh_stats->multiflag_expansions += name.size());
+      for (auto c = 0u; c < name.size(); ++c)
+      {
+         handler.flag(name.substr(c, 1));
+      }
+
+      name = keep_param;
+      return !keep_param.empty();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Handler>
+   inline bool parser_base::takes_value(string_view name, bool registered, int mode, Handler& handler)
+   {
+      // if 'name' is a pre-registered option, then the next arg cannot be a free parameter to it is skipped
+      // otherwise we have 2 modes:
+      // PREFER_FLAG_FOR_UNREG_OPTION: a non-registered 'name' is determined a flag. 
+      //                               The following value (the next arg) will be a free parameter.
+      //
+      // PREFER_PARAM_FOR_UNREG_OPTION: a non-registered 'name' is determined a parameter, the next arg
+      //                                will be the value of that option.
+
+      assert(!(mode & PREFER_FLAG_FOR_UNREG_OPTION)
+          || !(mode & PREFER_PARAM_FOR_UNREG_OPTION));
+
+      bool preferParam = mode & PREFER_PARAM_FOR_UNREG_OPTION;
+
+      return registered || preferParam || handler.is_param(name);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline bool parser_base::is_number(string_view arg)
+   {
+      ARGH_STATS(++argh_stats->is_number_calls);
+      // Determine if a string starts with a number (which can start with a '-') the same way `istream >> double` does:
+      // a numeric prefix is enough ("-1abc", "-0x1f" are numbers), a dangling exponent is not ("-1e"),
+      // "inf"/"nan" are not numbers, and values that overflow a double are not numbers.
+      auto it = arg.data(), end = arg.data() + arg.size();
+      while (it != end && std::isspace(static_cast<unsigned char>(*it)))
+         ++it;
+      auto const first = it;
+      if (it != end && ('-' == *it || '+' == *it))
+         ++it;
+
+      // mantissa, tracking the decimal magnitude of its first significant digit
+      long magnitude = 0;
+      bool digits = false, significant = false;
+      for (; it != end && std::isdigit(static_cast<unsigned char>(*it)); ++it, digits = true)
+      {
+         significant = significant || '0' != *it;
+         if (significant)
+            ++magnitude;
+      }
+      if (it != end && '.' == *it)
+      {
+         for (++it; it != end && std::isdigit(static_cast<unsigned char>(*it)); ++it, digits = true)
+         {
+            if (!significant && '0' == *it)
+               --magnitude;
+            significant = significant || '0' != *it;
+         }
+      }
+      if (!digits)
+         return false;
+
+      // optional exponent, which must have digits when present
+      long exponent = 0;
+      if (it != end && ('e' == *it || 'E' == *it))
+      {
+         ++it;
+         bool negative = false;
+         if (it != end && ('-' == *it || '+' == *it))
+            negative = '-' == *(it++);
+         if (it == end || !std::isdigit(static_cast<unsigned char>(*it)))
+            return false;
+         for (; it != end && std::isdigit(static_cast<unsigned char>(*it)); ++it)
+            exponent = (std::min)(exponent * 10 + (*it - '0'), 100000L); // clamped, anything this large overflows
+         if (negative)
+            exponent = -exponent;
+      }
+
+      // only values close to the limit need an exact overflow check, of the whole text however long
+      auto const max_magnitude = std::numeric_limits<double>::max_exponent10 + 1;
+      if (!significant || magnitude + exponent < max_magnitude)
+         return true;
+      if (magnitude + exponent > max_magnitude)
+         return false;
+      double number;
+      return from_chars(first, it, number);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline bool parser_base::is_option(string_view arg)
+   {
+      assert(0 != arg.size());
+      return classify(arg).option();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline parser_base::arg_info parser_base::classify(string_view arg, int mode)
+   {
+      arg_info info;
+      auto const dashes = count_leading(arg.data(), arg.size(), '-');
+      info.name = static_cast<std::uint32_t>(dashes < arg.size() ? dashes : 0); // all dashes: the name is the arg
+      info.equal = 0;
+
+      // only args starting with '-' are options, unless it is a negative number: '-' followed by a digit or '.'
+      bool option = 0 != dashes;
+      if (1 == dashes && arg.size() > 1 && (std::isdigit(static_cast<unsigned char>(arg[1])) || '.' == arg[1]))
+         option = !is_number(arg);
+      if (!option)
+      {
+         info.kind = arg_info::POSITIONAL;
+         return info;
+      }
+
+      info.kind = 1 == info.name ? arg_info::SHORT_OPTION : arg_info::OPTION;
+      if (!(mode & NO_SPLIT_ON_EQUALSIGN))
+      {
+         auto const name_size = arg.size() - info.name;
+         auto const equal = find_byte(arg.data() + info.name, name_size, '=');
+         if (equal != name_size)
+         {
+            info.kind = arg_info::ASSIGNMENT;
+            info.equal = static_cast<std::uint32_t>(equal);
+         }
+      }
+      return info;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+#if defined(ARGH_SSE2) || defined(ARGH_NEON)
+   namespace simd_detail
+   {
+      inline unsigned lowest_bit(std::uint64_t mask)
+      {
+#  if defined(_MSC_VER)
+         unsigned long ind;
+         _BitScanForward64(&ind, mask);
+         return static_cast<unsigned>(ind);
+#  else
+         return static_cast<unsigned>(__builtin_ctzll(mask));
+#  endif
+      }
+
+      // returns the index of the first byte in the 16 at p that equals (or if !equal, differs from) c, or 16
+      inline unsigned scan16(char const* p, char c, bool equal)
+      {
+#  if defined(ARGH_SSE2)
+         auto const eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p)), _mm_set1_epi8(c));
+         auto mask = static_cast<std::uint64_t>(_mm_movemask_epi8(eq));
+         if (!equal)
+            mask ^= 0xffff;
+         return mask ? lowest_bit(mask) : 16;
+#  else
+         auto eq = vceqq_u8(vld1q_u8(reinterpret_cast<std::uint8_t const*>(p)), vdupq_n_u8(static_cast<std::uint8_t>(c)));
+         if (!equal)
+            eq = vmvnq_u8(eq);
+         // narrow each byte of the comparison to 4 bits of a 64 bit mask
+         auto const mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+         return mask ? lowest_bit(mask) / 4 : 16;
+#  endif
+      }
+   }
+#endif
+
+   inline size_t parser_base::find_byte(char const* first, size_t size, char c)
+   {
+      size_t i = 0;
+#if defined(ARGH_SSE2) || defined(ARGH_NEON)
+      for (; i + 16 <= size; i += 16)
+      {
+         auto const found = simd_detail::scan16(first + i, c, true);
+         if (found < 16)
+            return i + found;
+      }
+#endif
+      for (; i < size; ++i)
+         if (c == first[i])
+            return i;
+      return size;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline size_t parser_base::count_leading(char const* first, size_t size, char c)
+   {
+      size_t i = 0;
+#if defined(ARGH_SSE2) || defined(ARGH_NEON)
+      for (; i + 16 <= size; i += 16)
+      {
+         auto const found = simd_detail::scan16(first + i, c, false);
+         if (found < 16)
+            return i + found;
+      }
+#endif
+      while (i < size && c == first[i])
+         ++i;
+      return i;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline string_view parser_base::trim_leading_dashes(string_view name)
+   {
+      // returns a slice of name, nothing is copied
+      auto pos = name.find_first_not_of('-');
+      return string_view::npos != pos ? name.substr(pos) : name;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline string_stream parser_base::bad_stream()
+   {
+      string_stream bad;
+      bad.setstate(std::ios_base::failbit);
+      return bad;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename T>
+   optional<T> parser_base::convert(string_view str)
+   {
+      T value;
+      if (from_chars(str.data(), str.data() + str.size(), value))
+         return value;
+      return {};
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::parse(const char * const argv[], int mode)
+   {
+      int argc = 0;
+      for (auto argvp = argv; *argvp; ++argc, ++argvp);
+      parse(argc, argv, mode);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::parse(int argc, const char* const argv[], int mode /*= PREFER_FLAG_FOR_UNREG_OPTION*/)
+   {
+      parse(argv, argv + argc, mode);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename Iterator>
+   inline void basic_parser<String, Storage, Allocator>::parse(Iterator first, Iterator last, int mode)
+   {
+#if defined(ARGH_ENABLE_STATS)
+      stats_scope scope(stats_);
+#endif
+      handler h{ *this, nullptr, 0 };
+      parse_args(first, last, mode, h);
+      merge_layers();
+      finish_parse();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::parse(std::vector<std::string>&& args, int mode)
+   {
+      if (std::is_same<String, string_view>::value)
+      {
+         // moving a vector keeps its strings in place, so the views stay valid
+         auto const owned = std::make_shared<std::vector<std::string> const>(std::move(args));
+         ownedArgs_.push_back(owned);
+         parse(owned->begin(), owned->end(), mode);
+         return;
+      }
+
+      std::vector<std::string> source(std::move(args));
+#if defined(ARGH_ENABLE_STATS)
+      stats_scope scope(stats_);
+#endif
+      handler h{ *this, &source, 0 };
+      parse_args(source.begin(), source.end(), mode, h);
+      merge_layers();
+      finish_parse();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::set_env_prefix(std::string const& prefix)
+   {
+      envPrefix_ = prefix;
+      useEnv_ = true;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline bool basic_parser<String, Storage, Allocator>::set_config_file(char const* path)
+   {
+      std::shared_ptr<mapped_file> map(new mapped_file(path));
+      if (!map->is_open())
+         return false;
+
+      configEntries_.clear();
+      auto trim = [](string_view str)
+      {
+         while (!str.empty() && std::isspace(static_cast<unsigned char>(str[0])))
+            str = str.substr(1);
+         while (!str.empty() && std::isspace(static_cast<unsigned char>(str[str.size() - 1])))
+            str = str.substr(0, str.size() - 1);
+         return str;
+      };
+      string_view text(map->data(), map->size());
+      while (!text.empty())
+      {
+         auto const eol = text.find('\n');
+         auto const line = trim(text.substr(0, eol));
+         text = string_view::npos == eol ? string_view() : text.substr(eol + 1);
+
+         auto const equal = line.find('=');
+         if (line.empty() || '#' == line[0] || string_view::npos == equal)
+            continue;
+         auto const key = trim(line.substr(0, equal));
+         if (!key.empty())
+            configEntries_.push_back({ key, trim(line.substr(equal + 1)) });
+      }
+      // the params a view parser merged from the previous file still refer to it
+      if (layersMerged_ && config_ && std::is_same<String, string_view>::value)
+         ownedArgs_.push_back(config_);
+      config_ = std::move(map);
+      layersMerged_ = false; // the next parse() merges the new file
+      return true;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::merge_layers()
+   {
+      if (layersMerged_ || (!useEnv_ && configEntries_.empty()))
+         return;
+      layersMerged_ = true;
+
+      // params keep their first value, so inserting after the command line gives it precedence.
+      // a MULTI_VALUE param only gets a layer's value if the command line had none.
+      handler h{ *this, nullptr, 0 };
+      auto const add = [&](string_view name, string_view value)
+      {
+         auto const values = multi_values(canonical(name));
+         if (!values || values->empty())
+            h.param(name, value);
+      };
+      if (useEnv_)
+      {
+         // a view parser refers to the names and values, so it keeps a copy with the owned args: names in
+         // registeredParams_ move when it grows or is copied, and the environment may change.
+         // Other parsers store their own copies, and add them directly.
+         bool const keep = std::is_same<String, string_view>::value;
+         std::shared_ptr<std::vector<std::string>> layer; // name, value, name, ...
+         std::string var;
+         for (auto const& name : registeredParams_)
+         {
+            var = envPrefix_;
+            for (auto c : name)
+               var += '-' == c ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            auto const value = std::getenv(var.c_str());
+            if (!value)
+               continue;
+            if (!keep)
+               add(name, value);
+            else
+            {
+               if (!layer)
+                  layer = std::make_shared<std::vector<std::string>>();
+               layer->push_back(name);
+               layer->push_back(value);
+            }
+         }
+         if (layer)
+         {
+            ownedArgs_.push_back(layer);
+            for (size_t i = 0; i < layer->size(); i += 2)
+               add((*layer)[i], (*layer)[i + 1]);
+         }
+      }
+      for (auto const& entry : configEntries_)
+         add(entry.first, entry.second);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::finish_parse()
+   {
+      cache_.clear(); // params may have been added
+
+      flagCounts_.finalize();
+      Storage::finalize(flags_);
+      Storage::finalize(params_);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline bool basic_parser<String, Storage, Allocator>::got_flag(string_view name) const
+   {
+      return 0 != flag_count(canonical(name));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline std::uint32_t basic_parser<String, Storage, Allocator>::flag_count(string_view key) const
+   {
+      if (1 == key.size())
+         return charFlags_.count(key[0]);
+      return flagCounts_.empty() ? 0 : flagCounts_.count(key);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline size_t basic_parser<String, Storage, Allocator>::count(string_view name) const
+   {
+      return flag_count(canonical(name));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline typename basic_parser<String, Storage, Allocator>::flag_set const& basic_parser<String, Storage, Allocator>::flags() const
+   {
+      if (!flagsStored_.done())
+      {
+         flagsStored_.run([this]
+         {
+            charFlags_.for_each([this](char c, std::uint32_t count)
+            {
+               for (std::uint32_t i = 0; i < count; ++i)
+                  flags_.emplace(store(char_flags::name(c)));
+            });
+            for (auto const& entry : flagCounts_)
+               for (std::uint32_t i = 0; i < entry.second; ++i)
+                  flags_.emplace(entry.first);
+            Storage::finalize(flags_);
+         });
+      }
+      return flags_;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline typename basic_parser<String, Storage, Allocator>::arg_vector* basic_parser<String, Storage, Allocator>::multi_values(string_view name)
+   {
+      if (multiParams_.empty())
+         return nullptr;
+      auto it = multiParams_.find(name);
+      return multiParams_.end() != it ? &multiValues_[static_cast<size_t>(it - multiParams_.begin())] : nullptr;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline typename basic_parser<String, Storage, Allocator>::arg_vector const& basic_parser<String, Storage, Allocator>::values(string_view name) const
+   {
+      name = canonical(name);
+      auto it = multiParams_.find(name);
+      return multiParams_.end() != it ? multiValues_[static_cast<size_t>(it - multiParams_.begin())] : noValues_;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline bool basic_parser<String, Storage, Allocator>::is_param(string_view name) const
+   {
+      return registeredParams_.end() != registeredParams_.find(name);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline typename basic_parser<String, Storage, Allocator>::param_map::const_iterator basic_parser<String, Storage, Allocator>::find_param(string_view name) const
+   {
+      return Storage::find(params_, canonical(name));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline typename basic_parser<String, Storage, Allocator>::param_map::const_iterator basic_parser<String, Storage, Allocator>::find_param(std::initializer_list<char const* const> init_list) const
+   {
+      // aliases of one registered param are found by a single lookup
+      string_view prev;
+      bool first = true;
+      for (auto& name : init_list)
+      {
+         auto const key = canonical(name);
+         if (!first && key == prev)
+            continue;
+         auto optIt = Storage::find(params_, key);
+         if (params_.end() != optIt)
+            return optIt;
+         prev = key;
+         first = false;
+      }
+      return params_.end();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline string_view basic_parser<String, Storage, Allocator>::canonical(string_view name) const
+   {
+      return resolve_alias(aliases_, trim_leading_dashes(name));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline bool basic_parser<String, Storage, Allocator>::operator[](string_view name) const
+   {
+      return got_flag(name);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline bool basic_parser<String, Storage, Allocator>::operator[](std::initializer_list<char const* const> init_list) const
+   {
+      // aliases of one param are looked up once
+      string_view prev;
+      bool first = true;
+      for (auto& name : init_list)
+      {
+         auto const key = canonical(name);
+         if (!first && key == prev)
+            continue;
+         if (0 != flag_count(key))
+            return true;
+         prev = key;
+         first = false;
+      }
+      return false;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline typename basic_parser<String, Storage, Allocator>::arg_vector::const_reference basic_parser<String, Storage, Allocator>::operator[](size_t ind) const
+   {
+      if (ind < pos_args_.size())
+         return pos_args_[ind];
+      return empty_;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::reset()
+   {
+      pos_args_.clear();
+      flags_.clear();
+      flagsStored_.reset();
+      flagCounts_.clear();
+      charFlags_.clear();
+      params_.clear();
+      cache_.clear();
+      for (auto& values : multiValues_)
+         values.clear();
+      layersMerged_ = false;
+      ownedArgs_.clear();
+#if defined(ARGH_ENABLE_STATS)
+      stats_.clear_counters();
+#endif
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::reparse(const char* const argv[], int mode)
+   {
+      reset();
+      parse(argv, mode);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::reparse(int argc, const char* const argv[], int mode)
+   {
+      reset();
+      parse(argc, argv, mode);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline string_stream basic_parser<String, Storage, Allocator>::operator()(string_view name) const
+   {
+      auto optIt = find_param(name);
+      if (params_.end() != optIt)
+         return string_stream(as_std_string(optIt->second));
+      return bad_stream();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline string_stream basic_parser<String, Storage, Allocator>::operator()(std::initializer_list<char const* const> init_list) const
+   {
+      auto optIt = find_param(init_list);
+      if (params_.end() != optIt)
+         return string_stream(as_std_string(optIt->second));
+      return bad_stream();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T>
+   string_stream basic_parser<String, Storage, Allocator>::operator()(string_view name, T&& def_val) const
+   {
+      auto optIt = find_param(name);
+      if (params_.end() != optIt)
+         return string_stream(as_std_string(optIt->second));
+
+      std::ostringstream ostr;
+      ostr << def_val;
+      return string_stream(ostr.str()); // use default
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   // same as above but for a list of names. returns the first value to be found.
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T>
+   string_stream basic_parser<String, Storage, Allocator>::operator()(std::initializer_list<char const* const> init_list, T&& def_val) const
+   {
+      auto optIt = find_param(init_list);
+      if (params_.end() != optIt)
+         return string_stream(as_std_string(optIt->second));
+
+      std::ostringstream ostr;
+      ostr << def_val;
+      return string_stream(ostr.str()); // use default
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline string_stream basic_parser<String, Storage, Allocator>::operator()(size_t ind) const
+   {
+      if (pos_args_.size() <= ind)
+         return bad_stream();
+
+      return string_stream(as_std_string(pos_args_[ind]));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T>
+   string_stream basic_parser<String, Storage, Allocator>::operator()(size_t ind, T&& def_val) const
+   {
+      if (pos_args_.size() <= ind)
+      {
+         std::ostringstream ostr;
+         ostr << def_val;
+         return string_stream(ostr.str());
+      }
+
+      return string_stream(as_std_string(pos_args_[ind]));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T>
+   optional<T> basic_parser<String, Storage, Allocator>::get(size_t ind) const
+   {
+      if (pos_args_.size() <= ind)
+         return {};
+      return convert<T>(pos_args_[ind]);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T, typename U>
+   T basic_parser<String, Storage, Allocator>::get(size_t ind, U&& def_val) const
+   {
+      return get<T>(ind).value_or(std::forward<U>(def_val));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T>
+   optional<T> basic_parser<String, Storage, Allocator>::get(string_view name) const
+   {
+      auto optIt = find_param(name);
+      if (params_.end() == optIt)
+         return {};
+      return convert<T>(optIt->second);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T>
+   optional<T> basic_parser<String, Storage, Allocator>::get(std::initializer_list<char const* const> init_list) const
+   {
+      auto optIt = find_param(init_list);
+      if (params_.end() != optIt)
+         return convert<T>(optIt->second);
+      return {};
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T, typename U>
+   T basic_parser<String, Storage, Allocator>::get(string_view name, U&& def_val) const
+   {
+      return get<T>(name).value_or(std::forward<U>(def_val));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T, typename U>
+   T basic_parser<String, Storage, Allocator>::get(std::initializer_list<char const* const> init_list, U&& def_val) const
+   {
+      return get<T>(init_list).value_or(std::forward<U>(def_val));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T>
+   optional<T> const& basic_parser<String, Storage, Allocator>::get_cached(string_view name) const
+   {
+      return cache_.get<optional<T>>(canonical(name), [&] { return get<T>(name); });
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   template<typename T, typename U>
+   T basic_parser<String, Storage, Allocator>::get_cached(string_view name, U&& def_val) const
+   {
+      auto const& value = get_cached<T>(name);
+      return value ? *value : T(std::forward<U>(def_val));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::add_param(std::string const& name, ParamKind kind /*= SINGLE_VALUE*/)
+   {
+      auto trimmed = trim_leading_dashes(name);
+      registeredParams_.insert_sorted(std::string(trimmed.data(), trimmed.size())); // kept sorted, so it can be shared read-only
+
+      if (MULTI_VALUE == kind && !multiParams_.count(trimmed))
+      {
+         multiParams_.insert_sorted(std::string(trimmed.data(), trimmed.size()));
+         auto const ind = multiParams_.find(trimmed) - multiParams_.begin();
+         multiValues_.insert(multiValues_.begin() + ind, arg_vector(alloc_));
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::add_param(std::initializer_list<char const* const> aliases, ParamKind kind /*= SINGLE_VALUE*/)
+   {
+      if (0 == aliases.size())
+         return;
+      auto const first = trim_leading_dashes(*aliases.begin());
+      add_param(std::string(first.data(), first.size()), kind);
+      auto const name = std::make_shared<std::string const>(first.data(), first.size());
+      for (auto it = std::next(aliases.begin()); it != aliases.end(); ++it)
+      {
+         auto trimmed = trim_leading_dashes(*it);
+         if (trimmed == first)
+            continue;
+         registeredParams_.insert_sorted(std::string(trimmed.data(), trimmed.size()));
+         aliases_.insert_sorted({ std::string(trimmed.data(), trimmed.size()), name });
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::add_params(std::initializer_list<char const* const> init_list)
+   {
+      for (auto& name : init_list)
+      {
+         auto trimmed = trim_leading_dashes(name);
+         registeredParams_.insert_sorted(std::string(trimmed.data(), trimmed.size()));
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename String, typename Storage, typename Allocator>
+   inline void basic_parser<String, Storage, Allocator>::add_option(option_spec const& spec, ParamKind kind /*= SINGLE_VALUE*/)
+   {
+      auto const name = trim_leading_dashes(spec.name), alias = trim_leading_dashes(spec.alias);
+      if (spec.is_param && alias.empty())
+         add_param(spec.name, kind);
+      else if (spec.is_param)
+         add_param({ spec.name, spec.alias }, kind);
+      else if (!alias.empty() && alias != name)
+      {
+         // a flag alias is stored under the name like a param alias, but not registered as a param
+         aliases_.insert_sorted({ std::string(alias.data(), alias.size()), std::make_shared<std::string const>(name.data(), name.size()) });
+      }
+      options_.push_back(spec);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Compile-time option schema.
+   // The full option set is declared as a constexpr table, names are resolved to integer slots once,
+   // and parse results are stored in a fixed-size array indexed by slot:
+   //
+   //    constexpr auto cli = argh::make_schema(argh::param("threads", "j"), argh::flag("verbose", "v"));
+   //    constexpr auto threads = cli.slot("threads"); // a misspelled name fails to compile
+   //    constexpr auto verbose = cli.slot("-v");
+   //
+   //    argh::schema_parser<cli.size()> cmdl(cli, argc, argv);
+   //    if (cmdl[verbose]) ...
+   //    auto n = cmdl.get<int>(threads, 1);
+
+   // Index of an option in a schema. Slots of unknown names are invalid and never set.
+   struct option_slot
+   {
+      size_t index;
+   };
+
+   // Not constexpr on purpose: reaching it while evaluating a constant expression is a compile error.
+   inline size_t unknown_option_name(size_t invalid_index) { return invalid_index; }
+
+   template<size_t N>
+   struct schema
+   {
+      static_assert(N > 0, "a schema needs at least one option");
+
+      option_spec options[N];
+
+      static constexpr size_t size() { return N; }
+
+      // Resolve a name or alias (leading dashes are ignored) to its slot.
+      // In a constant expression an unknown name fails to compile, at runtime it returns an invalid slot.
+      constexpr option_slot slot(const char* name) const { return find(skip_dashes(name), 0); }
+
+      // the options as a --help table or completion word list, see static_help() for a compile-time copy.
+      std::string help(help_format format = HELP_TEXT) const { return help_string(options, options + N, format); }
+
+      static constexpr const char* skip_dashes(const char* str) { return '-' == *str ? skip_dashes(str + 1) : str; }
+      static constexpr bool equal(const char* a, const char* b) { return *a == *b && ('\0' == *a || equal(a + 1, b + 1)); }
+
+      constexpr option_slot find(const char* name, size_t ind) const
+      {
+         return N == ind ? option_slot{ unknown_option_name(N) } :
+                (equal(skip_dashes(options[ind].name), name) ||
+                 ('\0' != *name && equal(skip_dashes(options[ind].alias), name))) ? option_slot{ ind } :
+                find(name, ind + 1);
+      }
+   };
+
+   template<typename... Specs>
+   constexpr schema<sizeof...(Specs)> make_schema(Specs const&... specs)
+   {
+      return { { specs... } };
+   }
+
+   // size of the rendered text of a schema, a constant expression for a constexpr schema in C++17.
+   template<size_t N>
+   ARGH_CPP17_CONSTEXPR size_t help_size(schema<N> const& options, help_format format = HELP_TEXT)
+   {
+      help_detail::text_sink measure{ nullptr, 0, 0 };
+      help_detail::render(options.options, options.options + N, format, measure);
+      return measure.size;
+   }
+
+   // The rendered text of a schema in a fixed buffer, built at compile time for a constexpr schema in C++17:
+   //    constexpr auto help = argh::static_help<argh::help_size(cli)>(cli);
+   //    std::fwrite(help.c_str(), 1, help.size(), stdout);
+   // A Size other than help_size() truncates or leaves trailing NULs.
+   template<size_t Size, size_t N>
+   ARGH_CPP17_CONSTEXPR fixed_text<Size> static_help(schema<N> const& options, help_format format = HELP_TEXT)
+   {
+      fixed_text<Size> text{};
+      help_detail::text_sink out{ text.chars, Size, 0 };
+      help_detail::render(options.options, options.options + N, format, out);
+      return text;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   // Parser for a fixed schema. Params of the schema are pre-registered, the same parsing modes and rules as basic_parser apply.
+   // Options that are not in the schema are collected by unknown().
+   template<size_t N, typename String = std::string>
+   class schema_parser : public parser_base
+   {
+   public:
+      explicit schema_parser(schema<N> const& options);
+
+      schema_parser(schema<N> const& options, int argc, const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+         : schema_parser(options)
+      {  parse(argc, argv, mode); }
+
+      void parse(int argc, const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+
+      // drop all parse results, keeping the schema and the vectors' capacity.
+      void reset();
+
+      // reset() and parse() a new command line.
+      void reparse(int argc, const char* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+      {
+         reset();
+         parse(argc, argv, mode);
+      }
+
+      // resolve a name or alias at runtime, returns an invalid slot for unknown names.
+      option_slot slot(string_view name) const;
+
+      std::vector<String> const& pos_args() const { return pos_args_; }
+      std::vector<String> const& unknown()  const { return unknown_;  }
+
+      typename std::vector<String>::const_iterator begin() const { return pos_args_.cbegin(); }
+      typename std::vector<String>::const_iterator end()   const { return pos_args_.cend();   }
+      size_t size()                                         const { return pos_args_.size();   }
+
+      //////////////////////////////////////////////////////////////////////////
+      // Accessors
+
+      // returns true if the flag appeared.
+      bool operator[](option_slot opt) const { return 0 != count(opt); }
+
+      // number of times the flag appeared.
+      size_t count(option_slot opt) const { return opt.index < N ? slots_[opt.index].count : 0; }
+
+      // returns positional arg string by order. Like argv[] but without the options
+      String const& operator[](size_t ind) const { return ind < pos_args_.size() ? pos_args_[ind] : empty_; }
+
+      // returns a std::istream that can be used to convert a parameter to a typed value.
+      string_stream operator()(option_slot opt) const;
+
+      // returns an empty optional if the parameter is missing or not convertible to T.
+      template<typename T>
+      optional<T> get(option_slot opt) const;
+
+      // same as above, but returns def_val if the param is missing or not convertible to T.
+      template<typename T, typename U>
+      T get(option_slot opt, U&& def_val) const { return get<T>(opt).value_or(std::forward<U>(def_val)); }
+
+   private:
+      struct entry
+      {
+         size_t count = 0;
+         bool has_value = false;
+         String value;
+      };
+
+      // stores the args classified by parse_args() into their slots
+      struct handler
+      {
+         schema_parser& self;
+
+         bool is_param(string_view name) const
+         {
+            auto opt = self.slot(name);
+            return opt.index < N && self.schema_.options[opt.index].is_param;
+         }
+         void positional(string_view arg) { self.pos_args_.emplace_back(arg.data(), arg.size()); }
+         void flag(string_view name)
+         {
+            auto opt = self.slot(name);
+            if (opt.index < N)
+               ++self.slots_[opt.index].count;
+            else
+               self.unknown_.emplace_back(name.data(), name.size());
+         }
+         void param(string_view name, string_view value)
+         {
+            auto opt = self.slot(name);
+            if (opt.index >= N)
+               self.unknown_.emplace_back(name.data(), name.size());
+            else if (!self.slots_[opt.index].has_value) // keep the first value, like basic_parser
+            {
+               self.slots_[opt.index].has_value = true;
+               self.slots_[opt.index].value = String(value.data(), value.size());
+            }
+         }
+      };
+
+      using index_entry = std::pair<string_view, size_t>;
+
+      schema<N> schema_;
+      std::array<index_entry, 2 * N> index_; // names and aliases sorted for binary search
+      size_t index_size_ = 0;
+      std::array<entry, N> slots_;
+      std::vector<String> pos_args_;
+      std::vector<String> unknown_;
+      String empty_;
+   };
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<size_t N, typename String>
+   schema_parser<N, String>::schema_parser(schema<N> const& options)
+      : schema_(options)
+   {
+      for (size_t i = 0; i < N; ++i)
+      {
+         index_[index_size_++] = { trim_leading_dashes(schema_.options[i].name), i };
+         auto alias = trim_leading_dashes(schema_.options[i].alias);
+         if (!alias.empty())
+            index_[index_size_++] = { alias, i };
+      }
+      std::sort(index_.begin(), index_.begin() + index_size_,
+                [](index_entry const& a, index_entry const& b) { return a.first < b.first; });
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<size_t N, typename String>
+   void schema_parser<N, String>::parse(int argc, const char* const argv[], int mode)
+   {
+      handler h{ *this };
+      parse_args(argv, argv + argc, mode, h);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<size_t N, typename String>
+   void schema_parser<N, String>::reset()
+   {
+      for (auto& slot : slots_)
+      {
+         slot.count = 0;
+         slot.has_value = false;
+      }
+      pos_args_.clear();
+      unknown_.clear();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<size_t N, typename String>
+   option_slot schema_parser<N, String>::slot(string_view name) const
+   {
+      name = trim_leading_dashes(name);
+      auto last = index_.begin() + index_size_;
+      auto it = std::lower_bound(index_.begin(), last, name,
+                                 [](index_entry const& a, string_view b) { return a.first < b; });
+      return option_slot{ (it != last && it->first == name) ? it->second : N };
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<size_t N, typename String>
+   string_stream schema_parser<N, String>::operator()(option_slot opt) const
+   {
+      if (opt.index >= N || !slots_[opt.index].has_value)
+         return bad_stream();
+      return string_stream(as_std_string(slots_[opt.index].value));
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<size_t N, typename String>
+   template<typename T>
+   optional<T> schema_parser<N, String>::get(option_slot opt) const
+   {
+      if (opt.index >= N || !slots_[opt.index].has_value)
+         return {};
+      return convert<T>(slots_[opt.index].value);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Batch parsing.
+   // Parse many command lines at once, optionally on several threads. The registered param names are
+   // shared read-only by all threads, and the results are stored in struct-of-arrays form with views into
+   // the parsed argv strings, which must outlive the results.
+
+   struct argv_span
+   {
+      int argc;
+      const char* const* argv;
+   };
+
+   struct batch_results
+   {
+      // The args of command line i are [offsets[i], offsets[i + 1]) of the matching arrays:
+      std::vector<string_view> pos_args;    std::vector<size_t> pos_args_offsets;
+      std::vector<string_view> flags;       std::vector<size_t> flags_offsets;       // in command line order
+      std::vector<string_view> param_names; std::vector<string_view> param_values;   // sorted, first value of a repeated param only
+      std::vector<size_t> params_offsets;
+      alias_map aliases;                    // the names are stored and looked up by their first name
+
+      // number of command lines
+      size_t size() const { return pos_args_offsets.empty() ? 0 : pos_args_offsets.size() - 1; }
+
+      size_t pos_args_count(size_t cmd) const { return pos_args_offsets[cmd + 1] - pos_args_offsets[cmd]; }
+
+      // positional arg ind of command line cmd, empty if out of range
+      string_view pos_arg(size_t cmd, size_t ind) const
+      {
+         return ind < pos_args_count(cmd) ? pos_args[pos_args_offsets[cmd] + ind] : string_view();
+      }
+
+      // true if the flag appeared in command line cmd
+      bool flag(size_t cmd, string_view name) const
+      {
+         name = resolve_alias(aliases, parser_base::trim_leading_dashes(name));
+         auto first = flags.begin() + flags_offsets[cmd], last = flags.begin() + flags_offsets[cmd + 1];
+         return last != std::find(first, last, name);
+      }
+
+      // the first value of the param in command line cmd
+      optional<string_view> param(size_t cmd, string_view name) const
+      {
+         name = resolve_alias(aliases, parser_base::trim_leading_dashes(name));
+         auto const first = param_names.begin() + params_offsets[cmd], last = param_names.begin() + params_offsets[cmd + 1];
+         auto const it = std::lower_bound(first, last, name);
+         if (last != it && *it == name)
+            return param_values[static_cast<size_t>(it - param_names.begin())];
+         return {};
+      }
+
+      // append the results of other after ours
+      void append(batch_results const& other)
+      {
+         if (pos_args_offsets.empty())
+            pos_args_offsets.push_back(0), flags_offsets.push_back(0), params_offsets.push_back(0);
+         auto join = [](std::vector<size_t>& offsets, std::vector<size_t> const& more)
+         {
+            auto const base = offsets.back();
+            for (auto it = std::next(more.begin()); it < more.end(); ++it)
+               offsets.push_back(base + *it);
+         };
+         if (other.pos_args_offsets.empty())
+            return;
+         join(pos_args_offsets, other.pos_args_offsets);
+         join(flags_offsets, other.flags_offsets);
+         join(params_offsets, other.params_offsets);
+         pos_args.insert(pos_args.end(), other.pos_args.begin(), other.pos_args.end());
+         flags.insert(flags.end(), other.flags.begin(), other.flags.end());
+         param_names.insert(param_names.end(), other.param_names.begin(), other.param_names.end());
+         param_values.insert(param_values.end(), other.param_values.begin(), other.param_values.end());
+      }
+   };
+
+   // Parse the command lines in [first, last) (a random access range of argv_span) with the given
+   // registered param names (e.g. parser::registered_params()), on up to `threads` threads.
+   // Results are in the order of the input. Parsing is reentrant, each thread only writes its own results.
+   template<typename Iterator>
+   batch_results parse_batch(Iterator first, Iterator last, flat_set<std::string> const& registered,
+                             int mode = parser_base::PREFER_FLAG_FOR_UNREG_OPTION,
+                             unsigned threads = std::thread::hardware_concurrency());
+
+   // the same, with the aliases of the names (e.g. parser::aliases()), which are stored under their first name.
+   template<typename Iterator>
+   batch_results parse_batch(Iterator first, Iterator last, flat_set<std::string> const& registered, alias_map const& aliases,
+                             int mode = parser_base::PREFER_FLAG_FOR_UNREG_OPTION,
+                             unsigned threads = std::thread::hardware_concurrency());
+
+   //////////////////////////////////////////////////////////////////////////
+
+   namespace batch_detail
+   {
+      struct handler
+      {
+         using param_list = std::vector<std::pair<string_view, string_view>>;
+
+         flat_set<std::string> const& registered;
+         alias_map const& aliases;
+         batch_results& results;
+         param_list& params; // of the current command line, in command line order
+
+         bool is_param(string_view name) const            { return registered.end() != registered.find(name); }
+         void positional(string_view arg)                  { results.pos_args.push_back(arg); }
+         void flag(string_view name)                       { results.flags.push_back(resolve_alias(aliases, name)); }
+         void param(string_view name, string_view value)   { params.emplace_back(resolve_alias(aliases, name), value); }
+
+         // store the params of the command line by name, keeping the first value of each, like parser
+         void finish_params()
+         {
+            using entry = param_list::value_type;
+            flat_detail::stable_sort_in_place(params.begin(), params.end(), [](entry const& a, entry const& b) { return a.first < b.first; });
+            for (auto it = params.begin(); it != params.end(); ++it)
+               if (params.begin() == it || std::prev(it)->first != it->first)
+               {
+                  results.param_names.push_back(it->first);
+                  results.param_values.push_back(it->second);
+               }
+            params.clear();
+         }
+      };
+
+      template<typename Iterator>
+      void parse_range(Iterator first, Iterator last, flat_set<std::string> const& registered, alias_map const& aliases,
+                       int mode, batch_results& results)
+      {
+         results.pos_args_offsets.assign(1, 0);
+         results.flags_offsets.assign(1, 0);
+         results.params_offsets.assign(1, 0);
+         handler::param_list params; // reused by every command line
+         handler h{ registered, aliases, results, params };
+         for (; first != last; ++first)
+         {
+            argv_span const span = *first;
+            parser_base::parse_args(span.argv, span.argv + span.argc, mode, h);
+            h.finish_params();
+            results.pos_args_offsets.push_back(results.pos_args.size());
+            results.flags_offsets.push_back(results.flags.size());
+            results.params_offsets.push_back(results.param_names.size());
+         }
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Iterator>
+   batch_results parse_batch(Iterator first, Iterator last, flat_set<std::string> const& registered, int mode, unsigned threads)
+   {
+      return parse_batch(first, last, registered, alias_map(), mode, threads);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Iterator>
+   batch_results parse_batch(Iterator first, Iterator last, flat_set<std::string> const& registered, alias_map const& aliases,
+                             int mode, unsigned threads)
+   {
+      auto const count = static_cast<size_t>(std::distance(first, last));
+      size_t const chunks = (std::max<size_t>)(1, (std::min<size_t>)(threads, count));
+
+      batch_results results;
+      results.aliases = aliases; // shares the first names the results point to
+      if (1 == chunks)
+      {
+         batch_detail::parse_range(first, last, registered, aliases, mode, results);
+         return results;
+      }
+
+      // one contiguous chunk of command lines per thread, merged in order afterwards
+      std::vector<batch_results> partial(chunks);
+      std::vector<std::thread> workers;
+      workers.reserve(chunks - 1);
+      auto chunk = [&](size_t i) { return first + static_cast<std::ptrdiff_t>(count * i / chunks); };
+      for (size_t i = 1; i < chunks; ++i)
+         workers.emplace_back([&, i] { batch_detail::parse_range(chunk(i), chunk(i + 1), registered, aliases, mode, partial[i]); });
+      batch_detail::parse_range(chunk(0), chunk(1), registered, aliases, mode, partial[0]);
+      for (auto& worker : workers)
+         worker.join();
+
+      for (auto& part : partial)
+         results.append(part);
+      return results;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Streaming parsing.
+   // arg_stream classifies args pushed one at a time (or as chunks of whitespace separated text) with the
+   // same rules as parse(), and reports them to a handler with the parse_args() interface as soon as they are known.
+   // It holds at most one option waiting for its value and one partial token, so the input is parsed in constant memory.
+   // The reported views are only valid during the handler call.
+
+   template<typename Handler>
+   class arg_stream : public parser_base
+   {
+   public:
+      explicit arg_stream(Handler& handler, int mode = PREFER_FLAG_FOR_UNREG_OPTION) : handler_(handler), mode_(mode) {}
+
+      // classify the next arg, which only has to be valid during the call.
+      void push(string_view arg);
+
+      // split a chunk of text on whitespace and push the tokens, a token may continue in the next chunk.
+      void push_chunk(string_view chunk);
+
+      // push the last partial token and report a trailing option as a flag. The stream can be reused after.
+      void finish();
+
+   private:
+      Handler& handler_;
+      int mode_;
+      bool havePending_ = false;
+      bool pendingRegistered_ = false;
+      std::string pending_;    // the option waiting for the next arg, which may be its value
+      std::string partial_;    // the token continued by the next chunk
+   };
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Handler>
+   void arg_stream<Handler>::push(string_view arg)
+   {
+      auto const info = classify(arg, mode_);
+      if (havePending_)
+      {
+         havePending_ = false;
+         if (!info.option() && takes_value(pending_, pendingRegistered_, mode_, handler_))
+         {
+            handler_.param(pending_, arg);
+            return;
+         }
+         handler_.flag(pending_);
+      }
+
+      string_view name = arg.substr(info.name);
+      bool registered = false;
+      switch (info.kind)
+      {
+      case arg_info::POSITIONAL:
+         handler_.positional(arg);
+         return;
+      case arg_info::ASSIGNMENT:
+         handler_.param(name.substr(0, info.equal), name.substr(info.equal + 1));
+         return;
+      case arg_info::SHORT_OPTION:
+         if (mode_ & SINGLE_DASH_IS_MULTIFLAG)
+         {
+            if (!split_multiflag(name, handler_))
+               return;
+            registered = true;
+         }
+         break;
+      case arg_info::OPTION:
+         break;
+      }
+
+      pending_.assign(name.data(), name.size()); // reuses the capacity, no allocation in steady state
+      pendingRegistered_ = registered;
+      havePending_ = true;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Handler>
+   void arg_stream<Handler>::push_chunk(string_view chunk)
+   {
+      auto const is_space = [](char c) { return 0 != std::isspace(static_cast<unsigned char>(c)); };
+      auto it = chunk.begin(), end = chunk.end();
+      while (it != end)
+      {
+         if (is_space(*it))
+         {
+            if (!partial_.empty())
+            {
+               push(partial_);
+               partial_.clear();
+            }
+            ++it;
+            continue;
+         }
+
+         auto const first = it;
+         it = std::find_if(it, end, is_space);
+         if (it == end)
+            partial_.append(first, it); // may continue in the next chunk
+         else if (partial_.empty())
+            push(string_view(first, static_cast<size_t>(it - first)));
+         else
+            partial_.append(first, it);
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Handler>
+   void arg_stream<Handler>::finish()
+   {
+      if (!partial_.empty())
+      {
+         push(partial_);
+         partial_.clear();
+      }
+      if (havePending_)
+      {
+         havePending_ = false;
+         handler_.flag(pending_);
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Response files.
+   // An "@path" arg is replaced by the args in the file at path. The file is memory-mapped copy-on-write
+   // and tokenized in place, so the expanded args are views into the mapping (only pages with quotes or
+   // escapes to remove are ever written, and thus copied).
+
+   // Expands @file args, recursively. Each file is mapped and tokenized once and cached, so repeated
+   // and nested references to the same file are not read again.
+   // The expanded args point into argv and into the mapped files, which stay mapped while the response_files
+   // lives, so it must outlive a view_parser of the expansion.
+   class response_files
+   {
+   public:
+      // expand the @file args in [first, last). Unreadable files and recursive references are kept as literal args.
+      // The returned vector is reused by the next call.
+      template<typename Iterator>
+      std::vector<string_view> const& expand(Iterator first, Iterator last);
+
+      std::vector<string_view> const& expand(int argc, const char* const argv[]) { return expand(argv, argv + argc); }
+
+      // number of files mapped so far
+      size_t mapped_files() const;
+
+      // Split [first, last) into whitespace separated tokens, in place. Quotes ('...' or "...") group
+      // whitespace into a token, a backslash escapes the next char (except in single quotes).
+      static void tokenize(char* first, char* last, std::vector<string_view>& tokens);
+
+   private:
+      struct file
+      {
+         std::unique_ptr<mapped_file> map;
+         std::vector<string_view> tokens;
+         bool expanding = false; // to detect recursive references
+      };
+
+      void expand_arg(string_view arg);
+
+      std::map<std::string, file> files_;
+      std::vector<string_view> args_;
+   };
+
+   //////////////////////////////////////////////////////////////////////////
+
+#if defined(ARGH_ENABLE_MAPPED_FILES) && defined(_WIN32)
+   inline mapped_file::mapped_file(char const* path)
+   {
+      HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (INVALID_HANDLE_VALUE == file)
+         return;
+      LARGE_INTEGER size;
+      if (::GetFileSizeEx(file, &size))
+      {
+         size_ = static_cast<size_t>(size.QuadPart);
+         if (0 == size_)
+            open_ = true; // empty files cannot be mapped
+         else if (HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr))
+         {
+            data_ = static_cast<char*>(::MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+            open_ = nullptr != data_;
+            ::CloseHandle(mapping);
+         }
+      }
+      ::CloseHandle(file);
+   }
+
+   inline mapped_file::~mapped_file()
+   {
+      if (data_)
+         ::UnmapViewOfFile(data_);
+   }
+#elif defined(ARGH_ENABLE_MAPPED_FILES)
+   inline mapped_file::mapped_file(char const* path)
+   {
+      int const fd = ::open(path, O_RDONLY);
+      if (fd < 0)
+         return;
+      struct stat st;
+      if (0 == ::fstat(fd, &st) && S_ISREG(st.st_mode))
+      {
+         size_ = static_cast<size_t>(st.st_size);
+         if (0 == size_)
+            open_ = true; // empty files cannot be mapped
+         else
+         {
+            void* ptr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (MAP_FAILED != ptr)
+            {
+               data_ = static_cast<char*>(ptr);
+               open_ = true;
+            }
+         }
+      }
+      ::close(fd);
+   }
+
+   inline mapped_file::~mapped_file()
+   {
+      if (data_)
+         ::munmap(data_, size_);
+   }
+#else
+   inline mapped_file::mapped_file(char const* path)
+   {
+      std::FILE* const file = std::fopen(path, "rb");
+      if (!file)
+         return;
+      char chunk[4096]; // the size is not known up front for all files, e.g. pipes
+      size_t read;
+      while (0 < (read = std::fread(chunk, 1, sizeof(chunk), file)))
+         buffer_.insert(buffer_.end(), chunk, chunk + read);
+      open_ = !std::ferror(file);
+      std::fclose(file);
+      data_ = buffer_.empty() ? nullptr : buffer_.data();
+      size_ = buffer_.size();
+   }
+
+   inline mapped_file::~mapped_file() {}
+#endif
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Iterator>
+   std::vector<string_view> const& response_files::expand(Iterator first, Iterator last)
+   {
+      args_.clear();
+      for (; first != last; ++first)
+         expand_arg(*first);
+      return args_;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline size_t response_files::mapped_files() const
+   {
+      size_t count = 0;
+      for (auto const& entry : files_)
+         count += entry.second.map->is_open();
+      return count;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline void response_files::expand_arg(string_view arg)
+   {
+      if (arg.size() < 2 || '@' != arg[0])
+      {
+         args_.push_back(arg);
+         return;
+      }
+
+      std::string path(arg.data() + 1, arg.size() - 1);
+      auto it = files_.find(path);
+      if (files_.end() == it)
+      {
+         it = files_.emplace(path, file()).first;
+         auto& f = it->second;
+         f.map.reset(new mapped_file(path.c_str()));
+         if (f.map->is_open())
+            tokenize(f.map->data(), f.map->data() + f.map->size(), f.tokens);
+      }
+
+      auto& f = it->second;
+      if (!f.map->is_open() || f.expanding)
+      {
+         args_.push_back(arg);
+         return;
+      }
+      f.expanding = true;
+      for (auto token : f.tokens) // map nodes are stable, nested expansions only add new files
+         expand_arg(token);
+      f.expanding = false;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline void response_files::tokenize(char* first, char* last, std::vector<string_view>& tokens)
+   {
+      auto const is_space = [](char c) { return 0 != std::isspace(static_cast<unsigned char>(c)); };
+      auto it = first;
+      for (;;)
+      {
+         while (it != last && is_space(*it))
+            ++it;
+         if (it == last)
+            return;
+
+         // unquoted and unescaped chars are only written once quotes or escapes were removed before them
+         auto const start = it;
+         auto out = it;
+         auto const put = [&out, &it](char c) { if (out != it) *out = c; ++out; };
+         char quote = 0;
+         for (; it != last; ++it)
+         {
+            char const c = *it;
+            if (quote)
+            {
+               if (quote == c)
+                  quote = 0;
+               else if ('\\' == c && '"' == quote && std::next(it) != last)
+                  put(*++it);
+               else
+                  put(c);
+            }
+            else if (is_space(c))
+               break;
+            else if ('"' == c || '\'' == c)
+               quote = c;
+            else if ('\\' == c && std::next(it) != last)
+               put(*++it);
+            else
+               put(c);
+         }
+         tokens.push_back(string_view(start, static_cast<size_t>(out - start)));
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Snapshots.
+   // parsed_view is an immutable copy of a parser's results in a few contiguous buffers. It has no mutable
+   // state, so any number of threads can read it without synchronisation, and its lookups never allocate.
+   // Publish a new snapshot on reload by swapping a shared_ptr:
+   //    std::atomic_store(&current, argh::make_parsed_view(cmdl));   // writer
+   //    auto view = std::atomic_load(&current);                       // readers
+
+   template<typename Table>
+   class basic_parsed_view : public parser_base
+   {
+   public:
+      // flag accessors
+      bool operator[](string_view name) const { return 0 != count(name); }
+      size_t count(string_view name) const;
+
+      // positional args
+      string_view operator[](size_t ind) const { return ind < pos_args_.size() ? pos_args_[ind] : string_view(); }
+      size_t size() const { return pos_args_.size(); }
+      typename Table::const_iterator begin() const { return pos_args_.begin(); }
+      typename Table::const_iterator end()   const { return pos_args_.end(); }
+
+      // the value of a param
+      optional<string_view> param(string_view name) const;
+
+      template<typename T>
+      optional<T> get(size_t ind) const { return ind < size() ? convert<T>(pos_args_[ind]) : optional<T>(); }
+
+      template<typename T>
+      optional<T> get(string_view name) const
+      {
+         auto value = param(name);
+         return value ? convert<T>(*value) : optional<T>();
+      }
+
+      template<typename T, typename U>
+      T get(string_view name, U&& def_val) const { return get<T>(name).value_or(std::forward<U>(def_val)); }
+
+   protected:
+      // index of the first key not less than key
+      static size_t lower_bound(Table const& keys, string_view key);
+
+      // the trimmed name, or the first name of its param or flag if it is an alias
+      string_view canonical(string_view name) const;
+
+      Table pos_args_;
+      Table flags_;        // sorted, with repeats
+      Table param_names_;  // sorted
+      Table param_values_;
+      Table alias_names_;  // sorted
+      Table alias_targets_;
+   };
+
+   class parsed_view : public basic_parsed_view<packed_strings<>>
+   {
+   public:
+      template<typename Parser>
+      explicit parsed_view(Parser const& cmdl);
+   };
+
+   template<typename Parser>
+   std::shared_ptr<parsed_view const> make_parsed_view(Parser const& cmdl)
+   {
+      return std::make_shared<parsed_view const>(cmdl);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Parser>
+   parsed_view::parsed_view(Parser const& cmdl)
+   {
+      // the parser containers iterate in sorted order, so they are copied as they are
+      for (auto const& arg : cmdl.pos_args())
+         pos_args_.push_back(arg);
+      for (auto const& flag : cmdl.flags())
+         flags_.push_back(flag);
+      for (auto const& param : cmdl.params())
+      {
+         param_names_.push_back(param.first);
+         param_values_.push_back(param.second);
+      }
+      for (auto const& alias : cmdl.aliases())
+      {
+         alias_names_.push_back(alias.first);
+         alias_targets_.push_back(*alias.second);
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Table>
+   inline size_t basic_parsed_view<Table>::count(string_view name) const
+   {
+      name = canonical(name);
+      size_t n = 0;
+      for (auto i = lower_bound(flags_, name); i < flags_.size() && flags_[i] == name; ++i)
+         ++n;
+      return n;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Table>
+   inline optional<string_view> basic_parsed_view<Table>::param(string_view name) const
+   {
+      name = canonical(name);
+      auto const i = lower_bound(param_names_, name);
+      if (i < param_names_.size() && param_names_[i] == name)
+         return param_values_[i];
+      return {};
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Table>
+   inline size_t basic_parsed_view<Table>::lower_bound(Table const& keys, string_view key)
+   {
+      size_t first = 0, count = keys.size();
+      while (count > 0)
+      {
+         auto const half = count / 2;
+         if (keys[first + half] < key)
+         {
+            first += half + 1;
+            count -= half + 1;
+         }
+         else
+            count = half;
+      }
+      return first;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Table>
+   inline string_view basic_parsed_view<Table>::canonical(string_view name) const
+   {
+      name = trim_leading_dashes(name);
+      auto const i = lower_bound(alias_names_, name);
+      return i < alias_names_.size() && alias_names_[i] == name ? alias_targets_[i] : name;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Binary blobs.
+   // to_blob() serialises a parser's results (positional args, flags, params, registered names and aliases) into a
+   // compact relocatable blob: tables of 32 bit offsets and NUL-terminated chars, with no pointers.
+   // parsed_blob serves the parsed_view accessors straight from a blob in memory, e.g. a mapped cache file, so a
+   // re-launch with the same command line (see argv_hash()) can skip parsing:
+   //    argh::parsed_blob cached;
+   //    argh::mapped_file file(path);
+   //    if (!file.is_open() || !cached.load(file.data(), file.size())) { parse, write argh::to_blob(cmdl) to path }
+   // Layout, native endian: "ARGH" version size, then per table: count, chars size, ends[count], chars, padded to 4.
+
+   // a read-only table of count strings in a blob, each followed by a NUL
+   class blob_table
+   {
+   public:
+      using value_type      = string_view;
+      using const_reference = string_view;
+      using const_iterator  = indexed_iterator<blob_table>;
+
+      blob_table() = default;
+      blob_table(std::uint32_t const* ends, char const* chars, size_t count) : ends_(ends), chars_(chars), count_(count) {}
+
+      string_view operator[](size_t ind) const
+      {
+         auto const first = ind ? ends_[ind - 1] + 1 : 0;
+         return string_view(chars_ + first, ends_[ind] - first);
+      }
+
+      const_iterator begin() const { return const_iterator(this, 0); }
+      const_iterator end()   const { return const_iterator(this, size()); }
+
+      size_t size()  const { return count_; }
+      bool   empty() const { return 0 == count_; }
+
+   private:
+      std::uint32_t const* ends_ = nullptr;
+      char const* chars_ = nullptr;
+      size_t count_ = 0;
+   };
+
+   class parsed_blob : public basic_parsed_view<blob_table>
+   {
+   public:
+      static const std::uint32_t version = 2;
+
+      // serve the blob at [data, data + size), which must be 4 byte aligned and outlive the parsed_blob.
+      // Returns false, and keeps the previous blob, if it is no valid blob of this version.
+      bool load(void const* data, size_t size);
+
+      blob_table const& registered_params() const { return registered_; }
+
+   private:
+      blob_table registered_;
+   };
+
+   template<typename Parser>
+   std::string to_blob(Parser const& cmdl);
+
+   // a hash of the args, to key cached blobs by command line (FNV-1a, 64 bit)
+   inline std::uint64_t argv_hash(int argc, const char* const argv[])
+   {
+      std::uint64_t hash = 14695981039346656037ull;
+      for (int i = 0; i < argc; ++i)
+         for (auto p = argv[i]; ; ++p) // the NUL too, so { "ab" } and { "a", "b" } differ
+         {
+            hash = (hash ^ static_cast<unsigned char>(*p)) * 1099511628211ull;
+            if (!*p)
+               break;
+         }
+      return hash;
+   }
+
+   namespace blob_detail
+   {
+      static const char magic[4] = { 'A', 'R', 'G', 'H' };
+
+      inline void put32(std::string& out, std::uint32_t value) { out.append(reinterpret_cast<char const*>(&value), sizeof(value)); }
+
+      template<typename Range>
+      void put_table(std::string& out, Range const& strings)
+      {
+         std::uint32_t count = 0, chars = 0;
+         for (auto const& str : strings)
+         {
+            ++count;
+            chars += static_cast<std::uint32_t>(string_view(str).size() + 1);
+         }
+         put32(out, count);
+         put32(out, chars);
+         std::uint32_t first = 0; // ends are one past the last char, at the NUL
+         for (auto const& str : strings)
+         {
+            auto const end = first + static_cast<std::uint32_t>(string_view(str).size());
+            put32(out, end);
+            first = end + 1;
+         }
+         for (auto const& str : strings)
+         {
+            auto const view = string_view(str);
+            out.append(view.data(), view.size());
+            out += '\0';
+         }
+         out.append((4 - out.size() % 4) % 4, '\0');
+      }
+
+      inline string_view as_view(string_view str)                               { return str; }
+      inline string_view as_view(std::shared_ptr<std::string const> const& str) { return *str; }
+
+      // the keys or values of a params() or aliases() container
+      template<typename Params>
+      struct param_range
+      {
+         Params const& params;
+         bool keys;
+
+         struct const_iterator
+         {
+            typename Params::const_iterator it;
+            bool keys;
+            string_view operator*() const { return keys ? as_view(it->first) : as_view(it->second); }
+            const_iterator& operator++() { ++it; return *this; }
+            bool operator!=(const_iterator const& other) const { return it != other.it; }
+         };
+         const_iterator begin() const { return { params.begin(), keys }; }
+         const_iterator end()   const { return { params.end(), keys }; }
+      };
+
+      // read a table at offset in [data, data + size), moving offset past it
+      inline bool get_table(char const* data, size_t size, size_t& offset, blob_table& table)
+      {
+         std::uint32_t header[2];
+         if (size - offset < sizeof(header))
+            return false;
+         std::memcpy(header, data + offset, sizeof(header));
+         auto const count = header[0], chars = header[1];
+         offset += sizeof(header);
+         if ((size - offset) / 4 < count || size - offset - count * size_t(4) < chars)
+            return false;
+
+         auto const ends = reinterpret_cast<std::uint32_t const*>(data + offset);
+         auto const text = data + offset + count * size_t(4);
+         std::uint32_t first = 0;
+         for (std::uint32_t i = 0; i < count; ++i)
+         {
+            if (ends[i] < first || ends[i] >= chars || '\0' != text[ends[i]])
+               return false;
+            first = ends[i] + 1;
+         }
+         table = blob_table(ends, text, count);
+         offset += count * size_t(4) + chars;
+         offset += (4 - offset % 4) % 4;
+         return offset <= size;
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Parser>
+   std::string to_blob(Parser const& cmdl)
+   {
+      std::string out(blob_detail::magic, sizeof(blob_detail::magic));
+      blob_detail::put32(out, parsed_blob::version);
+      blob_detail::put32(out, 0); // the size, set at the end
+
+      // the parser containers iterate in sorted order, so they are copied as they are
+      blob_detail::put_table(out, cmdl.pos_args());
+      blob_detail::put_table(out, cmdl.flags());
+      using params_type = typename std::decay<decltype(cmdl.params())>::type;
+      blob_detail::put_table(out, blob_detail::param_range<params_type>{ cmdl.params(), true });
+      blob_detail::put_table(out, blob_detail::param_range<params_type>{ cmdl.params(), false });
+      blob_detail::put_table(out, cmdl.registered_params());
+      blob_detail::put_table(out, blob_detail::param_range<alias_map>{ cmdl.aliases(), true });
+      blob_detail::put_table(out, blob_detail::param_range<alias_map>{ cmdl.aliases(), false });
+
+      auto const size = static_cast<std::uint32_t>(out.size());
+      std::memcpy(&out[8], &size, sizeof(size));
+      return out;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   inline bool parsed_blob::load(void const* data, size_t size)
+   {
+      auto const bytes = static_cast<char const*>(data);
+      std::uint32_t header[2];
+      if (0 != reinterpret_cast<std::uintptr_t>(data) % 4 || size < 12 || 0 != std::memcmp(bytes, blob_detail::magic, 4))
+         return false;
+      std::memcpy(header, bytes + 4, sizeof(header));
+      if (version != header[0] || header[1] > size)
+         return false;
+      size = header[1];
+
+      blob_table tables[7];
+      size_t offset = 12;
+      for (auto& table : tables)
+         if (!blob_detail::get_table(bytes, size, offset, table))
+            return false;
+      if (tables[2].size() != tables[3].size() || tables[5].size() != tables[6].size())
+         return false;
+
+      pos_args_      = tables[0];
+      flags_         = tables[1];
+      param_names_   = tables[2];
+      param_values_  = tables[3];
+      registered_    = tables[4];
+      alias_names_   = tables[5];
+      alias_targets_ = tables[6];
+      return true;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Sub-commands.
+   // basic_command_parser holds a parser for the global options and a pre-built parser per sub-command
+   // (e.g. `tool build -j 4`), each with its own registered params. It parses argv in one pass, switching
+   // to the command's table when the command is found.
+
+   template<typename Parser>
+   class basic_command_parser
+   {
+   public:
+      basic_command_parser() = default;
+
+      explicit basic_command_parser(std::initializer_list<char const* const> global_params)
+      {  global_.add_params(global_params); }
+
+      // register a sub-command and its params, once. Returns its parser, e.g. to register MULTI_VALUE params,
+      // which stays valid while the basic_command_parser lives.
+      Parser& add_command(std::string const& name, std::initializer_list<char const* const> params = {});
+
+      // Drop the previous results and parse argv. The command is the first positional arg after argv[0],
+      // the options before it go to global(), the command and all args after it to command(),
+      // with the command name as its arg 0. If that positional arg is no command, all args go to global().
+      void parse(int argc, const char* const argv[], int mode = parser_base::PREFER_FLAG_FOR_UNREG_OPTION);
+
+      Parser const& global() const { return global_; }
+
+      // the parser of the command found by parse(), nullptr if there was none.
+      Parser const* command() const { return command_; }
+
+      string_view command_name() const { return command_ ? string_view((*command_)[0]) : string_view(); }
+
+   private:
+      struct handler
+      {
+         basic_command_parser& self;
+         Parser* target;
+
+         bool is_param(string_view name) const { return target->is_param(name); }
+         void positional(string_view arg)
+         {
+            if (!self.command_ && 1 == self.global_.size())
+            {
+               auto it = self.commands_index_.find(arg);
+               if (self.commands_index_.end() != it)
+                  self.command_ = target = &self.commands_[it->second];
+            }
+            forward().positional(arg);
+         }
+         void flag(string_view name)                     { forward().flag(name); }
+         void param(string_view name, string_view value) { forward().param(name, value); }
+
+         typename Parser::handler forward() const { return typename Parser::handler{ *target, nullptr, 0 }; }
+      };
+
+      Parser global_;
+      std::deque<Parser> commands_;                          // stable references
+      flat_map<std::string, size_t> commands_index_;         // name to commands_ index
+      Parser* command_ = nullptr;
+   };
+
+   using command_parser = basic_command_parser<parser>;
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Parser>
+   Parser& basic_command_parser<Parser>::add_command(std::string const& name, std::initializer_list<char const* const> params)
+   {
+      auto it = commands_index_.find(name);
+      if (commands_index_.end() != it)
+      {
+         commands_[it->second].add_params(params);
+         return commands_[it->second];
+      }
+      commands_.emplace_back(params);
+      commands_index_.insert({ name, commands_.size() - 1 });
+      commands_index_.finalize();
+      return commands_.back();
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Parser>
+   void basic_command_parser<Parser>::parse(int argc, const char* const argv[], int mode)
+   {
+      global_.reset();
+      if (command_)
+         command_->reset();
+      command_ = nullptr;
+
+      handler h{ *this, &global_ };
+      parser_base::parse_args(argv, argv + argc, mode, h);
+
+      global_.merge_layers();
+      global_.finish_parse();
+      if (command_)
+      {
+         command_->merge_layers();
+         command_->finish_parse();
+      }
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Lazy parsing.
+   // basic_lazy_parser only records argv when constructed. The flag and param accessors parse it on demand,
+   // until the requested name is found, and iterating or the other accessors parse it all, once.
+   // e.g. a wrapper that checks one flag before exec'ing does not pay for the rest of its args:
+   //    argh::lazy_parser cmdl(argc, argv);
+   //    if (cmdl["dry-run"]) ...
+   // argv must outlive the parser. Accessors are safe from concurrent readers.
+
+   template<typename Parser>
+   class basic_lazy_parser
+   {
+   public:
+      basic_lazy_parser(int argc, const char* const argv[], int mode = parser_base::PREFER_FLAG_FOR_UNREG_OPTION) :
+         next_(argv), last_(argv + argc), mode_(mode)
+      {}
+
+      basic_lazy_parser(const char* const argv[], int mode = parser_base::PREFER_FLAG_FOR_UNREG_OPTION) :
+         basic_lazy_parser(count(argv), argv, mode)
+      {}
+
+      // register params before the first access
+      void add_param(std::string const& name, parser_base::ParamKind kind = parser_base::SINGLE_VALUE) { parser_.add_param(name, kind); }
+      void add_param(std::initializer_list<char const* const> aliases, parser_base::ParamKind kind = parser_base::SINGLE_VALUE) { parser_.add_param(aliases, kind); }
+      void add_params(std::initializer_list<char const* const> init_list) { parser_.add_params(init_list); }
+      void add_option(option_spec const& spec, parser_base::ParamKind kind = parser_base::SINGLE_VALUE) { parser_.add_option(spec, kind); }
+      std::string help(help_format format = HELP_TEXT) const { return parser_.help(format); }
+      void set_env_prefix(std::string const& prefix) { parser_.set_env_prefix(prefix); }
+      bool set_config_file(char const* path)          { return parser_.set_config_file(path); }
+
+      // parse until the flag is found, or to the end if it is missing.
+      bool operator[](string_view name) const
+      {  return resolve(FLAG, name, [name](Parser const& p) { return p[name]; }); }
+
+      // parse until the param is found, or to the end if it is missing.
+      string_stream operator()(string_view name) const
+      {  return resolve(PARAM, name, [name](Parser const& p) { return p(name); }); }
+
+      template<typename T>
+      string_stream operator()(string_view name, T&& def_val) const
+      {  return resolve(PARAM, name, [name, &def_val](Parser const& p) { return p(name, std::forward<T>(def_val)); }); }
+
+      template<typename T>
+      optional<T> get(string_view name) const
+      {  return resolve(PARAM, name, [name](Parser const& p) { return p.template get<T>(name); }); }
+
+      template<typename T, typename U>
+      T get(string_view name, U&& def_val) const
+      {  return resolve(PARAM, name, [name, &def_val](Parser const& p) { return p.template get<T>(name, std::forward<U>(def_val)); }); }
+
+      // the completely parsed command line, for all other accessors, e.g. cmdl->pos_args() or cmdl->count("v").
+      Parser const& all() const;
+      Parser const* operator->() const { return &all(); }
+
+      // whether all of argv has been parsed
+      bool parsed() const { return parsed_.done(); }
+
+      typename Parser::arg_vector::const_iterator begin() const { return all().begin(); }
+      typename Parser::arg_vector::const_iterator end()   const { return all().end();   }
+      size_t size()                                       const { return all().size();  }
+      typename Parser::arg_vector::const_reference operator[](size_t ind) const { return all()[ind]; }
+
+   private:
+      enum target { FLAG, PARAM, NONE };
+
+      // reports the args to the parser, watching for the target name
+      struct handler
+      {
+         Parser& parser;
+         target kind;
+         string_view key;
+         bool found;
+
+         bool is_param(string_view name) const { return parser.is_param(name); }
+         bool stop() const { return found; }
+         void positional(string_view arg) { forward().positional(arg); }
+         void flag(string_view name)
+         {
+            found = found || (FLAG == kind && parser.canonical(name) == key);
+            forward().flag(name);
+         }
+         void param(string_view name, string_view value)
+         {
+            found = found || (PARAM == kind && parser.canonical(name) == key);
+            forward().param(name, value);
+         }
+
+         typename Parser::handler forward() const { return typename Parser::handler{ parser, nullptr, 0 }; }
+      };
+
+      static int count(const char* const argv[])
+      {
+         int argc = 0;
+         for (auto argvp = argv; *argvp; ++argc, ++argvp);
+         return argc;
+      }
+
+      // read() the parser once `name` is resolved: under the latch while args are left, directly after.
+      template<typename Read>
+      auto resolve(target kind, string_view name, Read&& read) const -> decltype(read(std::declval<Parser const&>()));
+
+      // parse args until `name` is found as `kind`, or to the end. Called under the latch.
+      void parse_until(target kind, string_view name) const;
+
+      mutable Parser parser_;
+      mutable const char* const* next_;   // the first arg not parsed yet
+      const char* const* last_;
+      int mode_;
+      once_latch parsed_;
+   };
+
+   using lazy_parser = basic_lazy_parser<parser>;
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Parser>
+   Parser const& basic_lazy_parser<Parser>::all() const
+   {
+      if (!parsed_.done())
+      {
+         once_latch::guard lock(parsed_);
+         if (!parsed_.done())
+            parse_until(NONE, string_view());
+      }
+      return parser_;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Parser>
+   template<typename Read>
+   auto basic_lazy_parser<Parser>::resolve(target kind, string_view name, Read&& read) const -> decltype(read(std::declval<Parser const&>()))
+   {
+      if (parsed_.done())
+         return read(parser_);
+
+      once_latch::guard lock(parsed_);
+      if (!parsed_.done())
+      {
+         bool const present = FLAG == kind ? parser_[name] : parser_.params().end() != parser_.find_param(name);
+         if (!present)
+            parse_until(kind, name);
+      }
+      return read(parser_);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+
+   template<typename Parser>
+   void basic_lazy_parser<Parser>::parse_until(target kind, string_view name) const
+   {
+#if defined(ARGH_ENABLE_STATS)
+      typename Parser::stats_scope scope(parser_.stats_);
+#endif
+      // one scan, which stops after the arg that reports the target (an option with its value)
+      handler h{ parser_, kind, parser_.canonical(name), false };
+      auto const first = next_;
+      next_ = parser_base::parse_args(next_, last_, mode_, h);
+
+      if (next_ == last_)
+         parser_.merge_layers(); // only after the whole command line, which beats them
+      if (next_ != first || next_ == last_)
+         parser_.finish_parse(); // once per scan, the containers are only looked up after it
+      if (next_ == last_)
+         parsed_.finish();
+   }
+}
@@ -0,0 +1,282 @@
+#include "argh.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace argh;
+
+// Count heap allocations, so every benchmark can report allocations per parse next to its time.
+static size_t allocation_count = 0;
+
+void* operator new(size_t size)
+{
+   ++allocation_count;
+   if (void* ptr = std::malloc(size ? size : 1))
+      return ptr;
+   throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+// An argv that owns its strings.
+struct argv_holder
+{
+   std::vector<std::string> args;
+   std::vector<const char*> argv;
+
+   void add(std::string arg) { args.push_back(std::move(arg)); }
+
+   int argc() const { return static_cast<int>(argv.size()); }
+
+   const char* const* finish()
+   {
+      argv.clear();
+      for (auto& arg : args)
+         argv.push_back(arg.c_str());
+      return argv.data();
+   }
+};
+
+static argv_holder tiny_argv()
+{
+   argv_holder h;
+   for (auto arg : { "app", "-v", "--output", "out.txt", "input.txt" })
+      h.add(arg);
+   h.finish();
+   return h;
+}
+
+static argv_holder many_positionals_argv()
+{
+   argv_holder h;
+   h.add("app");
+   for (int i = 0; i < 10000; ++i)
+      h.add("file" + std::to_string(i) + ".txt");
+   h.finish();
+   return h;
+}
+
+static argv_holder multiflag_argv()
+{
+   argv_holder h;
+   h.add("app");
+   for (int i = 0; i < 1000; ++i)
+      h.add("-abcdefghijklmnop");
+   h.finish();
+   return h;
+}
+
+static argv_holder equal_params_argv()
+{
+   argv_holder h;
+   h.add("app");
+   for (int i = 0; i < 1000; ++i)
+      h.add("--param" + std::to_string(i) + "=value" + std::to_string(i));
+   h.finish();
+   return h;
+}
+
+static argv_holder negative_numbers_argv()
+{
+   argv_holder h;
+   h.add("app");
+   for (int i = 0; i < 1000; ++i)
+   {
+      h.add("--x" + std::to_string(i));
+      h.add("-" + std::to_string(i) + ".5e-3");
+   }
+   h.finish();
+   return h;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template<typename Parser>
+static void parse(benchmark::State& state, argv_holder const& h, int mode)
+{
+   size_t allocations = 0;
+   for (auto _ : state)
+   {
+      auto const before = allocation_count;
+      Parser cmdl(h.argc(), h.argv.data(), mode);
+      benchmark::DoNotOptimize(cmdl.size());
+      allocations += allocation_count - before;
+   }
+   state.counters["allocs/parse"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+   state.SetItemsProcessed(state.iterations() * (h.argc() - 1));
+}
+
+template<typename Parser>
+static void reparse(benchmark::State& state, argv_holder const& h, int mode)
+{
+   Parser cmdl;
+   cmdl.parse(h.argc(), h.argv.data(), mode);
+   size_t allocations = 0;
+   for (auto _ : state)
+   {
+      auto const before = allocation_count;
+      cmdl.reparse(h.argc(), h.argv.data(), mode);
+      benchmark::DoNotOptimize(cmdl.size());
+      allocations += allocation_count - before;
+   }
+   state.counters["allocs/parse"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+   state.SetItemsProcessed(state.iterations() * (h.argc() - 1));
+}
+
+#define ARGH_BENCH_PARSE(name, make_argv, mode)                                                         \
+   static void BM_parse_##name(benchmark::State& state)                                                 \
+   { static auto const h = make_argv(); parse<parser>(state, h, mode); }                                \
+   BENCHMARK(BM_parse_##name);                                                                          \
+   static void BM_parse_flat_view_##name(benchmark::State& state)                                       \
+   { static auto const h = make_argv(); parse<flat_view_parser>(state, h, mode); }                      \
+   BENCHMARK(BM_parse_flat_view_##name);                                                                \
+   static void BM_reparse_flat_view_##name(benchmark::State& state)                                     \
+   { static auto const h = make_argv(); reparse<flat_view_parser>(state, h, mode); }                    \
+   BENCHMARK(BM_reparse_flat_view_##name)
+
+ARGH_BENCH_PARSE(tiny,             tiny_argv,             parser::PREFER_FLAG_FOR_UNREG_OPTION);
+ARGH_BENCH_PARSE(many_positionals, many_positionals_argv, parser::PREFER_FLAG_FOR_UNREG_OPTION);
+ARGH_BENCH_PARSE(multiflag,        multiflag_argv,        parser::SINGLE_DASH_IS_MULTIFLAG);
+ARGH_BENCH_PARSE(equal_params,     equal_params_argv,     parser::PREFER_FLAG_FOR_UNREG_OPTION);
+ARGH_BENCH_PARSE(negative_numbers, negative_numbers_argv, parser::PREFER_PARAM_FOR_UNREG_OPTION);
+
+//////////////////////////////////////////////////////////////////////////
+
+template<typename Parser>
+static void flag_lookup(benchmark::State& state)
+{
+   static auto const h = multiflag_argv();
+   Parser cmdl(h.argc(), h.argv.data(), parser::SINGLE_DASH_IS_MULTIFLAG);
+   size_t allocations = 0;
+   for (auto _ : state)
+   {
+      auto const before = allocation_count;
+      benchmark::DoNotOptimize(cmdl["g"]);
+      benchmark::DoNotOptimize(cmdl["--missing"]);
+      allocations += allocation_count - before;
+   }
+   state.counters["allocs/iter"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_TEMPLATE(flag_lookup, parser);
+BENCHMARK_TEMPLATE(flag_lookup, flat_view_parser);
+
+template<typename Parser>
+static void param_lookup(benchmark::State& state)
+{
+   static auto const h = equal_params_argv();
+   Parser cmdl(h.argc(), h.argv.data());
+   size_t allocations = 0;
+   for (auto _ : state)
+   {
+      auto const before = allocation_count;
+      benchmark::DoNotOptimize(cmdl("param500").str());
+      benchmark::DoNotOptimize(cmdl.template get<string_view>("--param999"));
+      benchmark::DoNotOptimize(cmdl.template get<string_view>("missing"));
+      allocations += allocation_count - before;
+   }
+   state.counters["allocs/iter"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_TEMPLATE(param_lookup, parser);
+BENCHMARK_TEMPLATE(param_lookup, flat_view_parser);
+
+// a wrapper checking one flag: the lazy parser stops at it, the eager one parses all args
+template<typename Parser>
+static void first_flag(benchmark::State& state)
+{
+   static auto const h = multiflag_argv();
+   for (auto _ : state)
+   {
+      Parser cmdl(h.argc(), h.argv.data());
+      benchmark::DoNotOptimize(cmdl["abcdefghijklmnop"]);
+   }
+}
+BENCHMARK_TEMPLATE(first_flag, parser);
+BENCHMARK_TEMPLATE(first_flag, lazy_parser);
+
+//////////////////////////////////////////////////////////////////////////
+// Scaling: pathological argv shapes of growing size n, in every valid mode. Reports tokens/s and bytes/s,
+// and the fitted complexity over n, so superlinear behaviour shows up as a worse big-O.
+
+static argv_holder long_number_argv(int n) // one numeric-looking token of n digits
+{
+   argv_holder h;
+   h.add("app");
+   h.add("-" + std::string(static_cast<size_t>(n), '1') + ".5e-3");
+   h.finish();
+   return h;
+}
+
+static argv_holder long_multiflag_argv(int n) // one -aaaa... cluster of n chars
+{
+   argv_holder h;
+   h.add("app");
+   h.add("-" + std::string(static_cast<size_t>(n), 'a'));
+   h.finish();
+   return h;
+}
+
+static argv_holder colliding_params_argv(int n) // n =-split params sharing a long prefix
+{
+   argv_holder h;
+   h.add("app");
+   for (int i = 0; i < n; ++i)
+      h.add("--colliding_prefix_" + std::string(64, 'p') + std::to_string(i) + "=" + std::to_string(i));
+   h.finish();
+   return h;
+}
+
+template<argv_holder (*make_argv)(int)>
+static void scaling(benchmark::State& state)
+{
+   auto const n = static_cast<int>(state.range(0));
+   auto const mode = static_cast<int>(state.range(1));
+   auto const h = make_argv(n);
+   size_t bytes = 0;
+   for (auto& arg : h.args)
+      bytes += arg.size() + 1;
+
+   for (auto _ : state)
+   {
+      flat_view_parser cmdl(h.argc(), h.argv.data(), mode);
+      benchmark::DoNotOptimize(cmdl.size());
+   }
+   auto const tokens = static_cast<double>(state.iterations()) * (h.argc() - 1);
+   state.counters["tokens/s"] = benchmark::Counter(tokens, benchmark::Counter::kIsRate);
+   state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+   state.SetComplexityN(n);
+}
+
+// one family per shape and mode, so each gets its own complexity fit
+static void register_scaling(char const* shape, void (*fn)(benchmark::State&), int first, int last)
+{
+   for (int mode = 0; mode < 16; ++mode)
+   {
+      if ((mode & parser::PREFER_FLAG_FOR_UNREG_OPTION) && (mode & parser::PREFER_PARAM_FOR_UNREG_OPTION))
+         continue;
+      auto const name = std::string("scaling/") + shape + "/mode:" + std::to_string(mode);
+      benchmark::RegisterBenchmark(name.c_str(), fn)->RangeMultiplier(8)->Ranges({ { first, last }, { mode, mode } })->Complexity();
+   }
+}
+
+int main(int argc, char** argv)
+{
+   register_scaling("long_number",      scaling<long_number_argv>,      64, 1 << 18);
+   register_scaling("long_multiflag",   scaling<long_multiflag_argv>,   64, 1 << 18);
+   register_scaling("colliding_params", scaling<colliding_params_argv>, 8,  1 << 15);
+
+   benchmark::Initialize(&argc, argv);
+   if (benchmark::ReportUnrecognizedArguments(argc, argv))
+      return 1;
+   benchmark::RunSpecifiedBenchmarks();
+   return 0;
+}
@@ -0,0 +1,172 @@
+#include "argh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Fuzz harness. The first input byte picks the Mode bits, the rest is split into args on NUL bytes.
+// Every parser flavour must agree on the results, and no input may crash or assert.
+// Built with libFuzzer (-DARGH_LIBFUZZER), or as a driver that replays the files given on its
+// command line, or a built-in seed corpus of pathological shapes without any.
+
+using namespace argh;
+
+#define ARGH_FUZZ_CHECK(cond) do { if (!(cond)) { std::fprintf(stderr, "check failed: %s\n", #cond); std::abort(); } } while (false)
+
+namespace
+{
+   // records the events of parse_args() or arg_stream as text
+   struct recording_handler
+   {
+      std::string events;
+
+      bool is_param(string_view name) const { return name == "o" || name == "out"; }
+      void positional(string_view arg)       { events += 'P'; events.append(arg.data(), arg.size()); events += '\0'; }
+      void flag(string_view name)            { events += 'F'; events.append(name.data(), name.size()); events += '\0'; }
+      void param(string_view name, string_view value)
+      {
+         events += 'R';
+         events.append(name.data(), name.size());
+         events += '=';
+         events.append(value.data(), value.size());
+         events += '\0';
+      }
+   };
+
+   template<typename A, typename B>
+   bool same_results(A const& a, B const& b)
+   {
+      if (a.size() != b.size() || a.params().size() != b.params().size() || a.flags().size() != b.flags().size())
+         return false;
+      for (size_t i = 0; i < a.size(); ++i)
+         if (string_view(a[i]) != string_view(b[i]))
+            return false;
+      for (auto const& flag : a.flags())
+         if (a.count(flag) != b.count(flag))
+            return false;
+      for (auto const& param : a.params())
+         if (a(param.first).str() != b(param.first).str())
+            return false;
+      return true;
+   }
+
+   void run(std::uint8_t const* data, size_t size)
+   {
+      if (0 == size)
+         return;
+      int mode = data[0] & 0xf;
+      if ((mode & parser_base::PREFER_FLAG_FOR_UNREG_OPTION) && (mode & parser_base::PREFER_PARAM_FOR_UNREG_OPTION))
+         mode &= ~parser_base::PREFER_FLAG_FOR_UNREG_OPTION; // contradicting preferences
+
+      std::vector<std::string> args(1);
+      for (size_t i = 1; i < size; ++i)
+      {
+         if ('\0' == data[i])
+            args.emplace_back();
+         else
+            args.back() += static_cast<char>(data[i]);
+      }
+      std::vector<const char*> argv;
+      for (auto const& arg : args)
+         argv.push_back(arg.c_str());
+      auto const argc = static_cast<int>(argv.size());
+
+      parser cmdl({ "o", "out" });
+      cmdl.parse(argc, argv.data(), mode);
+      flat_view_parser view({ "o", "out" });
+      view.parse(argc, argv.data(), mode);
+      ARGH_FUZZ_CHECK(same_results(cmdl, view));
+
+      packed_parser packed({ "o", "out" });
+      packed.parse(std::vector<std::string>(args), mode);
+      ARGH_FUZZ_CHECK(same_results(cmdl, packed));
+
+      // streaming gives the same events as the batch classification
+      recording_handler expected, streamed;
+      parser_base::parse_args(argv.begin(), argv.end(), mode, expected);
+      arg_stream<recording_handler> stream(streamed, mode);
+      for (auto const& arg : args)
+         stream.push(arg);
+      stream.finish();
+      ARGH_FUZZ_CHECK(expected.events == streamed.events);
+
+      // a lazy lookup of any flag agrees with the eager parse
+      lazy_parser lazy(argc, argv.data(), mode);
+      lazy.add_params({ "o", "out" });
+      if (!cmdl.flags().empty())
+         ARGH_FUZZ_CHECK(lazy[*cmdl.flags().begin()]);
+      ARGH_FUZZ_CHECK(same_results(cmdl, *lazy.operator->()));
+
+      // blobs round trip, and the raw input is rejected or served without reading out of bounds
+      auto const blob = to_blob(cmdl);
+      parsed_blob loaded;
+      ARGH_FUZZ_CHECK(loaded.load(blob.data(), blob.size()));
+      ARGH_FUZZ_CHECK(loaded.size() == cmdl.size());
+      std::vector<std::uint32_t> aligned(size / 4 + 1);
+      std::memcpy(aligned.data(), data, size);
+      if (loaded.load(aligned.data(), size))
+         for (auto const& arg : loaded)
+            (void)loaded.count(arg);
+
+      std::string text(reinterpret_cast<char const*>(data), size);
+      std::vector<string_view> tokens;
+      response_files::tokenize(&text[0], &text[0] + text.size(), tokens);
+   }
+
+   // inputs that used to be, or could become, superlinear
+   std::vector<std::string> seeds()
+   {
+      std::vector<std::string> seeds;
+      auto add = [&](int mode, std::vector<std::string> const& args)
+      {
+         std::string input(1, static_cast<char>(mode));
+         for (auto const& arg : args)
+            input += arg + '\0';
+         seeds.push_back(input);
+      };
+      for (int mode = 0; mode < 16; ++mode)
+      {
+         add(mode, { "app", "-v", "--out", "x", "-o=1", "--", "-", "-1", "-.5e-3", "--a=b=c", "-xvo", "pos" });
+         add(mode, { "app", "-" + std::string(100000, '1') + ".5e-3", "-1e" + std::string(5000, '9') });
+         if (mode & 3)
+            continue; // the large inputs once per multi-flag and '=' split setting
+         add(mode, { "app", "-" + std::string(1 << 20, 'a') });
+         std::vector<std::string> params(1, "app");
+         for (int i = 0; i < 20000; ++i)
+            params.push_back("--colliding_prefix_" + std::string(64, 'p') + std::to_string(i) + "=" + std::to_string(i));
+         add(mode, params);
+      }
+      return seeds;
+   }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(std::uint8_t const* data, size_t size)
+{
+   run(data, size);
+   return 0;
+}
+
+#if !defined(ARGH_LIBFUZZER)
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      for (auto const& seed : seeds())
+         run(reinterpret_cast<std::uint8_t const*>(seed.data()), seed.size());
+      return 0;
+   }
+   for (int i = 1; i < argc; ++i)
+   {
+      std::ifstream file(argv[i], std::ios::binary);
+      std::string input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      run(reinterpret_cast<std::uint8_t const*>(input.data()), input.size());
+   }
+   return 0;
+}
+#endif
@@ -0,0 +1,41 @@
+// The parse statistics are compiled in with ARGH_ENABLE_STATS only, so they are tested in their own
+// executable and argh_tests.cpp covers the default build without them.
+#define ARGH_ENABLE_STATS
+#include "argh.h"
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <string>
+
+using namespace argh;
+
+TEST_CASE("Test parse stats and trace")
+{
+   const char* argv[] = { "app", "-xvf", "42", "--name=n", "-1", "--out", "o", "in" };
+   parser cmdl({ "out" });
+   std::string events;
+   cmdl.stats().trace = [&events](parse_stats::event kind, string_view name, string_view value)
+   {
+      events += "PFR"[kind] + std::string(name) + (value.empty() ? "" : "=" + std::string(value)) + ' ';
+   };
+   cmdl.parse(8, argv, parser::SINGLE_DASH_IS_MULTIFLAG);
+
+   auto const& stats = cmdl.stats();
+   CHECK(8 == stats.tokens);
+   CHECK(4 == stats.positionals);        // app, 42, -1, in
+   CHECK(3 == stats.flags);
+   CHECK(2 == stats.params);
+   CHECK(3 == stats.multiflag_expansions);
+   CHECK(1 == stats.equal_splits);
+   CHECK(1 == stats.is_number_calls);    // only -1 needs the number check
+   CHECK(9 == stats.insertions);
+   CHECK(events == "Papp Fx Fv Ff P42 Rname=n P-1 Rout=o Pin ");
+
+   cmdl.parse(8, argv, parser::SINGLE_DASH_IS_MULTIFLAG); // adds up
+   CHECK(16 == stats.tokens);
+   cmdl.reset();
+   CHECK(0 == stats.tokens);
+   CHECK(0 == stats.elapsed.count());
+   CHECK(stats.trace);  // kept
+}
@@ -3,8 +3,32 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 
+#include <clocale>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+
 using namespace argh;
 
+// Count heap allocations to check the allocation-free paths.
+static size_t allocation_count = 0;
+
+void* operator new(size_t size)
+{
+   ++allocation_count;
+   if (void* ptr = std::malloc(size ? size : 1))
+      return ptr;
+   throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+#endif
+
 TEST_CASE("Test empty cmdl") 
 {
     parser cmdl;
@@ -764,3 +788,1560 @@ TEST_CASE("Test size() member function")
       CHECK(cmdl.flags().size() == cmdl.size());
    }
 }
+
+TEST_CASE("Test view_parser borrows argv")
+{
+   const char* argv[] = { "0", "-a", "1", "--b=2", "-xv", "3", "--c", "4" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   view_parser cmdl;
+   cmdl.add_param("c");
+   cmdl.parse(argc, argv, parser::SINGLE_DASH_IS_MULTIFLAG);
+
+   CHECK(3 == cmdl.size());
+   CHECK(cmdl[0] == "0");
+   CHECK(cmdl[1] == "1");
+   CHECK(cmdl[2] == "3");
+   CHECK(cmdl[10].empty());
+
+   // stored values are slices of the original argv strings, nothing is copied
+   CHECK(cmdl[0].data() == argv[0]);
+   CHECK(cmdl[1].data() == argv[2]);
+   CHECK(cmdl.params().begin()->second.data() == argv[3] + 4);
+
+   CHECK(cmdl["a"]);
+   CHECK(cmdl["-x"]);
+   CHECK(cmdl["v"]);
+   CHECK(!cmdl["xv"]);
+   CHECK(cmdl[{ "q", "v" }]);
+   CHECK(3 == cmdl.flags().size());
+
+   CHECK(cmdl("b").str() == "2");
+   CHECK(cmdl("--c").str() == "4");
+   CHECK(cmdl({ "q", "c" }).str() == "4");
+   CHECK(cmdl("d", 7).str() == "7");
+
+   int val = -1;
+   CHECK((cmdl(1) >> val));
+   CHECK(1 == val);
+   CHECK(!(cmdl(10) >> val));
+
+   std::string joined;
+   for (auto& pos_arg : cmdl)
+      joined += std::string(pos_arg);
+   CHECK(joined == "013");
+}
+
+TEST_CASE("Test view_parser matches parser")
+{
+   const char* argv[] = { "-xvf", "42", "--abc", "54", "-1.5", "--e=", "-g" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   int modes[] = { parser::PREFER_FLAG_FOR_UNREG_OPTION,
+                   parser::PREFER_PARAM_FOR_UNREG_OPTION,
+                   parser::NO_SPLIT_ON_EQUALSIGN,
+                   parser::PREFER_PARAM_FOR_UNREG_OPTION | parser::SINGLE_DASH_IS_MULTIFLAG };
+   for (int mode : modes)
+   {
+      parser owning({ "f" });
+      owning.parse(argc, argv, mode);
+      view_parser viewing({ "f" });
+      viewing.parse(argc, argv, mode);
+
+      REQUIRE(owning.size() == viewing.size());
+      for (size_t i = 0; i < owning.size(); ++i)
+         CHECK(owning[i] == std::string(viewing[i]));
+
+      REQUIRE(owning.flags().size() == viewing.flags().size());
+      CHECK(std::equal(owning.flags().begin(), owning.flags().end(), viewing.flags().begin(),
+                       [](std::string const& a, string_view b) { return a == b; }));
+
+      REQUIRE(owning.params().size() == viewing.params().size());
+      for (auto& param : owning.params())
+         CHECK(viewing(param.first).str() == param.second);
+   }
+}
+
+TEST_CASE("Test typed get accessors")
+{
+   const char* argv[] = { "0", "-1", "17", "--threads=8", "--ratio=-2.5e-1", "--big=99999999999", "--on=true", "--bad=12abc", "--name=argh" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   parser cmdl(argc, argv);
+
+   CHECK(*cmdl.get<int>(0) == 0);
+   CHECK(*cmdl.get<int>(1) == -1);
+   CHECK(*cmdl.get<unsigned>(2) == 17u);
+   CHECK(!cmdl.get<unsigned>(1));
+   CHECK(!cmdl.get<int>(3));
+   CHECK(cmdl.get<int>(3, 42) == 42);
+   CHECK(cmdl.get<int>(2, 42) == 17);
+
+   CHECK(cmdl.get<int>("threads").has_value());
+   CHECK(*cmdl.get<int>("--threads") == 8);
+   CHECK(*cmdl.get<double>("ratio") == doctest::Approx(-0.25));
+   CHECK(*cmdl.get<float>("ratio") == doctest::Approx(-0.25f));
+   CHECK(*cmdl.get<long long>("big") == 99999999999ll);
+   CHECK(!cmdl.get<int>("big"));           // out of range
+   CHECK(*cmdl.get<bool>("on"));
+   CHECK(!cmdl.get<int>("bad"));           // the whole value must convert
+   CHECK(!cmdl.get<double>("bad"));
+   CHECK(!cmdl.get<int>("missing"));
+   CHECK(cmdl.get<int>("missing", 4) == 4);
+   CHECK(cmdl.get<int>("bad", 4) == 4);
+   CHECK(cmdl.get<std::string>("name", "none") == "argh");
+   CHECK(cmdl.get<string_view>("name")->data() == cmdl.params().at("name").data());
+
+   CHECK(*cmdl.get<int>({ "t", "threads" }) == 8);
+   CHECK(cmdl.get<int>({ "t", "j" }, 1) == 1);
+
+   CHECK(*cmdl.get<signed char>(2) == 17);
+   signed char small = 0;
+   CHECK(!from_chars("128", "128" + 3, small));
+   int min_int = 0;
+   CHECK(from_chars("-2147483648", "-2147483648" + 11, min_int));
+   CHECK(min_int == std::numeric_limits<int>::min());
+}
+
+TEST_CASE("Test floating point conversion takes long values and ignores the locale")
+{
+   auto const tiny = "0." + std::string(200, '0') + "1";
+   auto const huge = std::string(300, '1') + ".5";
+   const char* argv[] = { "app", "--tiny", tiny.c_str(), "--huge", huge.c_str() };
+   parser cmdl(5, argv, parser::PREFER_PARAM_FOR_UNREG_OPTION);
+   CHECK(*cmdl.get<double>("tiny") == doctest::Approx(1e-201));
+   CHECK(*cmdl.get<double>("huge") == doctest::Approx(1.1111111111111111e299));
+   CHECK(!cmdl.get<float>("huge"));
+
+   // '.' is the decimal point whatever the locale, where such a locale is installed
+   for (auto name : { "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "German" })
+   {
+      if (!std::setlocale(LC_NUMERIC, name))
+         continue;
+      double value = 0;
+      CHECK(from_chars("1.5", "1.5" + 3, value));
+      CHECK(value == 1.5);
+      CHECK(!from_chars("1,5", "1,5" + 3, value));
+      break;
+   }
+   std::setlocale(LC_NUMERIC, "C");
+}
+
+TEST_CASE("Test typed get accessors on view_parser")
+{
+   const char* argv[] = { "--threads=8", "--ratio", "0.5", "file" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   view_parser cmdl(argc, argv, parser::PREFER_PARAM_FOR_UNREG_OPTION);
+
+   CHECK(*cmdl.get<int>("threads") == 8);
+   CHECK(*cmdl.get<double>("ratio") == doctest::Approx(0.5));
+   CHECK(cmdl.get<string_view>(0)->data() == argv[3]);
+   CHECK(cmdl.get<std::string>(1, "none") == "none");
+}
+
+TEST_CASE("Test negative number detection matches istream extraction")
+{
+   const char* args[] = { "-1", "-0", "-1abc", "-1e", "-1e+", "-1e5x", "-1E-2", "-.5", "-.", "-1.", "-0x1f",
+                          "-inf", "-nan", "-e", "- 1", "-", "--1", "-+1", "-1..2", "-1.e3", "-.e3", "-1,0",
+                          "-1e308", "-1e309", "-1e-999", "-0e999", "-1.7976931348623157e308", "-1.7976931348623159e308",
+                          "-0.00017976931348623159e312", "-1e99999999999999999999" };
+   // near the limit, longer than any stack buffer
+   auto const zeros = std::string(300, '0');
+   std::string const long_args[] = { "-" + zeros + "1e308", "-" + zeros + "2e308", "-0." + zeros + "1e609", "-1" + zeros + "e8" };
+   std::vector<const char*> all(std::begin(args), std::end(args));
+   for (auto& arg : long_args)
+      all.push_back(arg.c_str());
+   for (auto arg : all)
+   {
+      std::istringstream istr(arg);
+      double number;
+      istr >> number;
+      bool const expected_number = !(istr.fail() || istr.bad());
+
+      const char* argv[] = { arg };
+      parser cmdl(1, argv);
+      INFO(arg);
+      CHECK(expected_number == (1 == cmdl.size()));
+      CHECK(expected_number == cmdl.flags().empty());
+   }
+}
+
+TEST_CASE("Test look-ahead classification is reused")
+{
+   const char* argv[] = { "-a", "-b", "-1", "-c", "v", "-d", "w" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   parser cmdl({ "b", "c" });
+   cmdl.parse(argc, argv);
+   CHECK(cmdl["a"]);
+   CHECK(cmdl("b").str() == "-1");
+   CHECK(cmdl("c").str() == "v");
+   CHECK(cmdl["d"]);
+   CHECK(1 == cmdl.size());
+   CHECK(cmdl[0] == "w");
+}
+
+TEST_CASE_TEMPLATE("Test storage policies give the same results", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   const char* argv[] = { "0", "-xvf", "42", "--abc", "54", "-v", "--d=1", "--d=2", "-1.5", "-g" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   int modes[] = { parser::PREFER_FLAG_FOR_UNREG_OPTION,
+                   parser::PREFER_PARAM_FOR_UNREG_OPTION,
+                   parser::NO_SPLIT_ON_EQUALSIGN,
+                   parser::SINGLE_DASH_IS_MULTIFLAG,
+                   parser::PREFER_PARAM_FOR_UNREG_OPTION | parser::SINGLE_DASH_IS_MULTIFLAG };
+   for (int mode : modes)
+   {
+      parser reference({ "f" });
+      reference.parse(argc, argv, mode);
+      Parser cmdl({ "f", "-f", "zzz" });
+      cmdl.parse(argc, argv, mode);
+
+      REQUIRE(reference.size() == cmdl.size());
+      for (size_t i = 0; i < reference.size(); ++i)
+         CHECK(reference[i] == std::string(cmdl[i]));
+
+      // same contents, in the same (sorted) order
+      REQUIRE(reference.flags().size() == cmdl.flags().size());
+      auto flagIt = cmdl.flags().begin();
+      for (auto& flag : reference.flags())
+      {
+         CHECK(flag == std::string(*flagIt++));
+         CHECK(reference.flags().count(flag) == cmdl.flags().count(flag));
+         CHECK(cmdl[flag]);
+      }
+
+      REQUIRE(reference.params().size() == cmdl.params().size());
+      auto paramIt = cmdl.params().begin();
+      for (auto& param : reference.params())
+      {
+         CHECK(param.first == std::string(paramIt->first));
+         CHECK(param.second == std::string(paramIt->second));
+         CHECK(cmdl(param.first).str() == param.second);
+         ++paramIt;
+      }
+      CHECK(!cmdl["zzz"]);
+      CHECK(!cmdl("zzz"));
+   }
+}
+
+TEST_CASE("Test flat storage keeps the first value of a repeated param")
+{
+   const char* argv[] = { "--d=1", "--e", "x", "--d=2" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   flat_parser cmdl;
+   cmdl.parse(argc, argv, parser::PREFER_PARAM_FOR_UNREG_OPTION);
+   CHECK(2 == cmdl.params().size());
+   CHECK(cmdl("d").str() == "1");
+
+   const char* argv2[] = { "--d=3", "--a=0", "-v" };
+   cmdl.parse(3, argv2);
+   CHECK(3 == cmdl.params().size());
+   CHECK(cmdl("d").str() == "1");
+   CHECK(cmdl("a").str() == "0");
+   CHECK(cmdl.params().begin()->first == "a");
+   CHECK(cmdl["v"]);
+}
+
+TEST_CASE("Test lookups do not allocate")
+{
+   const char* argv[] = { "--a-rather-long-flag-name", "--threads=8", "--a-rather-long-param-name", "value" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   flat_parser cmdl({ "a-rather-long-param-name" });
+   cmdl.parse(argc, argv);
+
+   auto const before = allocation_count;
+   CHECK(cmdl["a-rather-long-flag-name"]);
+   CHECK(cmdl["---a-rather-long-flag-name"]);
+   CHECK(cmdl[{ "x", "--a-rather-long-flag-name" }]);
+   CHECK(!cmdl["a-rather-long-flag-name-but-missing"]);
+   CHECK(*cmdl.get<int>("--threads") == 8);
+   CHECK(cmdl.get<string_view>({ "y", "a-rather-long-param-name" })->size() == 5);
+   CHECK(allocation_count == before);
+
+   // std::string keys are compared in place too
+   std::string const key = "--a-rather-long-flag-name";
+   auto const before_key = allocation_count;
+   CHECK(cmdl[key]);
+   CHECK(allocation_count == before_key);
+}
+
+constexpr auto test_schema = make_schema(argh::param("threads", "j"), argh::flag("verbose", "v"), argh::flag("-x"), argh::param("--out"));
+constexpr auto threads_slot = test_schema.slot("threads");
+constexpr auto verbose_slot = test_schema.slot("-v");
+static_assert(0 == threads_slot.index, "name resolves at compile time");
+static_assert(0 == test_schema.slot("--j").index, "alias resolves at compile time");
+static_assert(1 == verbose_slot.index, "alias resolves at compile time");
+static_assert(2 == test_schema.slot("x").index, "dashes are ignored");
+static_assert(3 == test_schema.slot("out").index, "dashes are ignored");
+
+TEST_CASE("Test compile-time schema")
+{
+   const char* argv[] = { "app", "-j", "8", "--verbose", "-v", "-x", "in", "--out=file", "--unknown", "-y", "5" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   schema_parser<test_schema.size()> cmdl(test_schema, argc, argv);
+
+   CHECK(*cmdl.get<int>(threads_slot) == 8);
+   CHECK(cmdl(threads_slot).str() == "8");
+   CHECK(cmdl[verbose_slot]);
+   CHECK(2 == cmdl.count(verbose_slot));
+   CHECK(cmdl[test_schema.slot("x")]);
+   CHECK(!cmdl[threads_slot]);
+   CHECK(cmdl.get<std::string>(test_schema.slot("out"), "") == "file");
+
+   CHECK(3 == cmdl.size());
+   CHECK(cmdl[0] == "app");
+   CHECK(cmdl[1] == "in");
+   CHECK(cmdl[2] == "5");
+   CHECK(cmdl[3].empty());
+
+   REQUIRE(2 == cmdl.unknown().size());
+   CHECK(cmdl.unknown()[0] == "unknown");
+   CHECK(cmdl.unknown()[1] == "y");
+
+   // runtime resolution
+   CHECK(1 == cmdl.slot("--verbose").index);
+   CHECK(test_schema.size() == cmdl.slot("nope").index);
+   CHECK(test_schema.size() == test_schema.slot("nope").index);
+   CHECK(!cmdl[cmdl.slot("nope")]);
+   CHECK(!cmdl.get<int>(cmdl.slot("nope")));
+   CHECK(!cmdl(cmdl.slot("nope")));
+}
+
+TEST_CASE("Test compile-time schema with multi-flags")
+{
+   const char* argv[] = { "-vxj", "4", "-xv" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   schema_parser<test_schema.size(), string_view> cmdl(test_schema, argc, argv, parser::SINGLE_DASH_IS_MULTIFLAG);
+
+   CHECK(2 == cmdl.count(verbose_slot));
+   CHECK(2 == cmdl.count(test_schema.slot("x")));
+   CHECK(*cmdl.get<int>(threads_slot) == 4);
+   CHECK(cmdl.get<string_view>(threads_slot)->data() == argv[1]);
+   CHECK(0 == cmdl.size());
+}
+
+TEST_CASE("Test parse results allocated from an arena")
+{
+   const char* argv[] = { "app", "--a-rather-long-flag-name", "-xvf", "--threads=8", "--a-rather-long-param-name",
+                          "a-rather-long-param-value", "a-rather-long-positional-arg" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   alignas(max_align_t) static char buffer[16 * 1024];
+   monotonic_arena arena(buffer, sizeof(buffer));
+   {
+      auto const before = allocation_count;
+      arena_allocator<char> alloc(arena);
+      arena_parser cmdl(alloc);
+      cmdl.parse(argc, argv, parser::SINGLE_DASH_IS_MULTIFLAG | parser::PREFER_PARAM_FOR_UNREG_OPTION);
+      CHECK(allocation_count == before); // everything came from the arena
+      CHECK(0 < arena.used());
+      CHECK(!arena.overflowed());
+
+      CHECK(cmdl["a-rather-long-flag-name"]);
+      CHECK(cmdl["x"]);
+      CHECK(cmdl["v"]);
+      CHECK(cmdl["f"]);
+      CHECK(cmdl("a-rather-long-param-name").str() == "a-rather-long-param-value");
+      CHECK(*cmdl.get<int>("threads") == 8);
+      CHECK(2 == cmdl.size());
+      CHECK(cmdl[1] == "a-rather-long-positional-arg");
+      CHECK(cmdl.pos_args().get_allocator().arena() == &arena);
+   }
+   arena.reset();
+   CHECK(0 == arena.used());
+   {
+      auto const before = allocation_count;
+      arena_view_parser cmdl(argc, argv, parser::PREFER_PARAM_FOR_UNREG_OPTION, arena_allocator<char>(arena));
+      CHECK(allocation_count == before);
+      CHECK(cmdl("threads").str() == "8");
+      CHECK(cmdl[1].data() == argv[6]);
+   }
+}
+
+TEST_CASE("Test arena overflows to the heap")
+{
+   const char* argv[] = { "-a", "-b", "-c", "-d", "-e", "-f", "-g", "-h", "p1", "p2", "p3", "p4" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   alignas(max_align_t) char buffer[64];
+   monotonic_arena arena(buffer, sizeof(buffer));
+   {
+      arena_parser cmdl(argc, argv, parser::PREFER_FLAG_FOR_UNREG_OPTION, arena_allocator<char>(arena));
+      CHECK(arena.overflowed());
+      CHECK(8 == cmdl.flags().size());
+      CHECK(cmdl["h"]);
+      CHECK(4 == cmdl.size());
+      CHECK(cmdl[3] == "p4");
+   }
+   arena.reset();
+   CHECK(!arena.overflowed());
+}
+
+TEST_CASE_TEMPLATE("Test reset() and reparse() reuse the parser", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   Parser cmdl({ "o" });
+   const char* argv1[] = { "app", "-o", "first", "-v", "input" };
+   cmdl.parse(5, argv1);
+   CHECK(cmdl("o").str() == "first");
+   CHECK(cmdl["v"]);
+   CHECK(2 == cmdl.size());
+
+   const char* argv2[] = { "app", "-o", "second", "-q" };
+   cmdl.reparse(4, argv2);
+   CHECK(cmdl("o").str() == "second"); // not the stale first value
+   CHECK(!cmdl["v"]);
+   CHECK(cmdl["q"]);
+   CHECK(1 == cmdl.size());
+   CHECK(1 == cmdl.params().size());
+   CHECK(1 == cmdl.flags().size());
+
+   cmdl.reset();
+   CHECK(0 == cmdl.size());
+   CHECK(cmdl.flags().empty());
+   CHECK(cmdl.params().empty());
+
+   // registered params survive a reset
+   const char* argv3[] = { "-o", "third" };
+   cmdl.parse(2, argv3);
+   CHECK(cmdl("o").str() == "third");
+}
+
+TEST_CASE("Test steady-state reparse does not allocate")
+{
+   const char* argv[] = { "app", "--a-rather-long-flag-name", "-o", "out", "--threads=8", "in1", "in2" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   flat_view_parser cmdl({ "o" });
+   cmdl.parse(argc, argv);
+
+   auto const before = allocation_count;
+   for (int i = 0; i < 3; ++i)
+   {
+      cmdl.reparse(argc, argv);
+      CHECK(3 == cmdl.size());
+      CHECK(cmdl.get<string_view>("o")->size() == 3);
+      CHECK(*cmdl.get<int>("threads") == 8);
+   }
+   CHECK(allocation_count == before);
+}
+
+TEST_CASE("Test steady-state reparse of unsorted and repeated params does not allocate")
+{
+   std::vector<std::string> args(1, "app");
+   for (int i = 40; i > 0; --i)
+      args.push_back("--param" + std::to_string(i % 25) + "=value" + std::to_string(i));
+   std::vector<const char*> argv;
+   for (auto& arg : args)
+      argv.push_back(arg.c_str());
+   int argc = static_cast<int>(argv.size());
+   flat_view_parser cmdl;
+   cmdl.parse(argc, argv.data());
+
+   auto const before = allocation_count;
+   for (int i = 0; i < 3; ++i)
+   {
+      cmdl.reparse(argc, argv.data());
+      CHECK(25 == cmdl.params().size());
+      CHECK(*cmdl.get<string_view>("param15") == "value40"); // the first of its repeats
+      CHECK(*cmdl.get<string_view>("param0") == "value25");
+      CHECK(*cmdl.get<string_view>("param1") == "value26");
+   }
+   CHECK(allocation_count == before);
+   CHECK(std::is_sorted(cmdl.params().begin(), cmdl.params().end()));
+}
+
+TEST_CASE("Test schema_parser reparse")
+{
+   const char* argv1[] = { "-v", "-j", "2", "file" };
+   const char* argv2[] = { "--nope" };
+   schema_parser<test_schema.size()> cmdl(test_schema, 4, argv1);
+   CHECK(cmdl[verbose_slot]);
+   cmdl.reparse(1, argv2);
+   CHECK(!cmdl[verbose_slot]);
+   CHECK(!cmdl.get<int>(threads_slot));
+   CHECK(0 == cmdl.size());
+   CHECK(1 == cmdl.unknown().size());
+}
+
+TEST_CASE("Test parse_batch matches parser on each command line")
+{
+   const char* argv1[] = { "app", "-o", "one", "-v", "in1" };
+   const char* argv2[] = { "app", "--threads=4", "-v", "-o", "two", "-o", "dup" };
+   const char* argv3[] = { "app" };
+   const char* argv4[] = { "app", "in2", "in3", "-q" };
+   std::vector<argv_span> lines;
+   for (int i = 0; i < 25; ++i)
+   {
+      lines.push_back({ 5, argv1 });
+      lines.push_back({ 7, argv2 });
+      lines.push_back({ 1, argv3 });
+      lines.push_back({ 4, argv4 });
+   }
+
+   parser cmdl({ "o" });
+   for (unsigned threads : { 0u, 1u, 3u, 8u, 200u })
+   {
+      auto results = parse_batch(lines.begin(), lines.end(), cmdl.registered_params(), parser::PREFER_FLAG_FOR_UNREG_OPTION, threads);
+      REQUIRE(results.size() == lines.size());
+      for (size_t i = 0; i < lines.size(); ++i)
+      {
+         cmdl.reparse(lines[i].argc, lines[i].argv);
+         CHECK(results.pos_args_count(i) == cmdl.size());
+         for (size_t j = 0; j < cmdl.size(); ++j)
+            CHECK(std::string(results.pos_arg(i, j)) == cmdl[j]);
+         CHECK(results.flag(i, "v") == cmdl["v"]);
+         CHECK(results.flag(i, "-q") == cmdl["q"]);
+         CHECK(results.param(i, "o").value_or("") == cmdl("o").str());
+         CHECK(results.param(i, "threads").value_or("") == cmdl("threads").str());
+      }
+   }
+
+   auto empty = parse_batch(lines.begin(), lines.begin(), cmdl.registered_params());
+   CHECK(0 == empty.size());
+}
+
+TEST_CASE("Test parse_batch keeps the first value of many repeated params")
+{
+   // 26 params out of order, each given twice
+   std::vector<std::string> args = { "app" };
+   for (int round = 0; round < 2; ++round)
+      for (char c = 'z'; c >= 'a'; --c)
+         args.push_back(std::string("--") + c + c + '=' + std::to_string(round));
+   std::vector<const char*> argv;
+   for (auto const& arg : args)
+      argv.push_back(arg.c_str());
+   std::vector<argv_span> lines = { { static_cast<int>(argv.size()), argv.data() }, { 1, argv.data() } };
+
+   auto results = parse_batch(lines.begin(), lines.end(), flat_set<std::string>(), parser::PREFER_FLAG_FOR_UNREG_OPTION, 1);
+   REQUIRE(2 == results.size());
+   CHECK(26 == results.params_offsets[1]);
+   for (char c = 'a'; c <= 'z'; ++c)
+      CHECK(results.param(0, std::string(2, c)).value_or("") == "0");
+   CHECK(!results.param(1, "aa"));
+}
+
+namespace
+{
+   // records the events of parse_args() or arg_stream as text
+   struct recording_handler
+   {
+      std::vector<std::string> registered;
+      std::string events;
+
+      bool is_param(string_view name) const { return registered.end() != std::find(registered.begin(), registered.end(), std::string(name)); }
+      void positional(string_view arg)       { events += "pos:" + std::string(arg) + ' '; }
+      void flag(string_view name)            { events += "flag:" + std::string(name) + ' '; }
+      void param(string_view name, string_view value) { events += "param:" + std::string(name) + '=' + std::string(value) + ' '; }
+   };
+}
+
+TEST_CASE("Test parse_args stops before the next arg once the handler asks")
+{
+   struct stopping_handler : recording_handler
+   {
+      stopping_handler(size_t n) : recording_handler{ { "o", "c" }, "" }, limit(n) {}
+      size_t limit;
+      bool stop() const { return std::count(events.begin(), events.end(), ' ') >= static_cast<std::ptrdiff_t>(limit); }
+   };
+   const char* argv[] = { "app", "-o", "out", "-abc", "pos", "--in=a", "-v" };
+   for (size_t limit = 0; limit <= 8; ++limit)
+   {
+      stopping_handler h(limit);
+      auto const stop = parser_base::parse_args(argv, argv + 7, parser_base::SINGLE_DASH_IS_MULTIFLAG, h);
+      recording_handler rest{ { "o", "c" }, "" };
+      parser_base::parse_args(stop, argv + 7, parser_base::SINGLE_DASH_IS_MULTIFLAG, rest);
+
+      recording_handler all{ { "o", "c" }, "" };
+      parser_base::parse_args(argv, argv + 7, parser_base::SINGLE_DASH_IS_MULTIFLAG, all);
+      CHECK(h.events + rest.events == all.events); // an option is never split from its value
+   }
+}
+
+TEST_CASE("Test arg_stream reports the same events as parse")
+{
+   std::vector<std::string> words = { "-o", "out", "--in=a", "-v", "-1", "pos", "-abc", "-x", "--", "-2.5", "-o" };
+   for (int mode : std::initializer_list<int>{ parser_base::PREFER_FLAG_FOR_UNREG_OPTION, parser_base::PREFER_PARAM_FOR_UNREG_OPTION, parser_base::SINGLE_DASH_IS_MULTIFLAG,
+                     parser_base::NO_SPLIT_ON_EQUALSIGN | parser_base::PREFER_PARAM_FOR_UNREG_OPTION })
+   {
+      std::vector<const char*> argv;
+      for (auto& word : words)
+         argv.push_back(word.c_str());
+
+      recording_handler expected{ { "o", "c" }, "" };
+      parser_base::parse_args(argv.begin(), argv.end(), mode, expected);
+
+      // one arg at a time, from a temporary buffer
+      recording_handler pushed{ { "o", "c" }, "" };
+      arg_stream<recording_handler> stream(pushed, mode);
+      for (auto& word : words)
+      {
+         std::string temporary = word;
+         stream.push(temporary);
+      }
+      stream.finish();
+      CHECK(pushed.events == expected.events);
+
+      // as text split in chunks of every size, tokens crossing the chunk boundaries
+      std::string text = "  ";
+      for (auto& word : words)
+         text += word + (word.size() % 2 ? "\n" : " \t ");
+      for (size_t chunk = 1; chunk <= text.size(); ++chunk)
+      {
+         recording_handler chunked{ { "o", "c" }, "" };
+         arg_stream<recording_handler> chunk_stream(chunked, mode);
+         for (size_t i = 0; i < text.size(); i += chunk)
+            chunk_stream.push_chunk(string_view(text.data() + i, std::min(chunk, text.size() - i)));
+         chunk_stream.finish();
+         CHECK(chunked.events == expected.events);
+      }
+   }
+}
+
+namespace
+{
+   // the per-arg parse rules, one scan and one is_param() call at a time
+   void reference_parse(std::vector<std::string> const& args, int mode, recording_handler& handler)
+   {
+      auto is_option = [](std::string const& arg) { return !arg.empty() && '-' == arg[0] && !parser_base::is_number(arg); };
+      for (size_t i = 0; i < args.size(); ++i)
+      {
+         auto const& arg = args[i];
+         if (!is_option(arg))
+         {
+            handler.positional(arg);
+            continue;
+         }
+         std::string name = std::string(parser_base::trim_leading_dashes(arg));
+         auto const equal = name.find('=');
+         if (!(mode & parser_base::NO_SPLIT_ON_EQUALSIGN) && std::string::npos != equal)
+         {
+            handler.param(name.substr(0, equal), name.substr(equal + 1));
+            continue;
+         }
+         if ((mode & parser_base::SINGLE_DASH_IS_MULTIFLAG) && 1 == arg.size() - name.size() && !handler.is_param(name))
+         {
+            std::string param;
+            if (handler.is_param(name.substr(name.size() - 1)))
+            {
+               param = name.substr(name.size() - 1);
+               name.pop_back();
+            }
+            for (char c : name)
+               handler.flag(std::string(1, c));
+            if (param.empty())
+               continue;
+            name = param;
+         }
+         if (i + 1 < args.size() && !is_option(args[i + 1]) && (handler.is_param(name) || (mode & parser_base::PREFER_PARAM_FOR_UNREG_OPTION)))
+            handler.param(name, args[++i]);
+         else
+            handler.flag(name);
+      }
+   }
+}
+
+TEST_CASE("Test parse_args matches the per-arg rules in every mode")
+{
+   std::vector<std::string> words = { "-o", "out", "--in=a", "-v", "-1", "pos", "-abc", "x", "-ab", "-c", "v", "-co=1", "--", "-", "-2.5", "-.x",
+                                      "---o", "=", "-=", "--k=", "-oc", "-o", "-abo" };
+   std::vector<const char*> argv;
+   for (auto& word : words)
+      argv.push_back(word.c_str());
+
+   for (int mode = 0; mode < 16; ++mode)
+   {
+      if ((mode & parser_base::PREFER_FLAG_FOR_UNREG_OPTION) && (mode & parser_base::PREFER_PARAM_FOR_UNREG_OPTION))
+         continue; // contradicting preferences
+      recording_handler expected{ { "o", "c", "ab" }, "" };
+      reference_parse(words, mode, expected);
+      recording_handler actual{ { "o", "c", "ab" }, "" };
+      parser_base::parse_args(argv.begin(), argv.end(), mode, actual);
+      CHECK(actual.events == expected.events);
+   }
+}
+
+TEST_CASE("Test response_files tokenizes quotes and escapes in place")
+{
+   char text[] = "  plain \"double quoted\" 'single \\ quoted' esc\\ aped\\\"  mix'ed  'up\"\\\"\" \"\" \\";
+   std::vector<string_view> tokens;
+   response_files::tokenize(text, text + sizeof(text) - 1, tokens);
+   std::vector<std::string> expected = { "plain", "double quoted", "single \\ quoted", "esc aped\"", "mixed  up\"", "", "\\" };
+   REQUIRE(tokens.size() == expected.size());
+   for (size_t i = 0; i < expected.size(); ++i)
+      CHECK(std::string(tokens[i]) == expected[i]);
+}
+
+TEST_CASE_TEMPLATE("Test @file expansion", Parser, doctest::Types<parser, view_parser>)
+{
+   {
+      std::ofstream("argh_test_a.rsp") << "-o \"out file\"\n@argh_test_b.rsp @argh_test_b.rsp esc\\ aped @argh_test_missing.rsp";
+      std::ofstream("argh_test_b.rsp") << "-v @argh_test_a.rsp";
+   }
+
+   const char* argv[] = { "app", "@argh_test_a.rsp", "last", "@" };
+   response_files files;
+   auto const& args = files.expand(4, argv);
+   CHECK(2 == files.mapped_files()); // b is mapped once, the missing file is not
+
+   Parser cmdl({ "o" });
+   cmdl.parse(args.begin(), args.end());
+   CHECK(cmdl("o").str() == "out file");
+   CHECK(cmdl["v"]);
+   CHECK(cmdl.size() == 7);
+   CHECK(cmdl[0] == "app");
+   CHECK(cmdl[1] == "@argh_test_a.rsp"); // recursive reference kept as is, after -v
+   CHECK(cmdl[2] == "@argh_test_a.rsp");
+   CHECK(cmdl[3] == "esc aped");
+   CHECK(cmdl[4] == "@argh_test_missing.rsp");
+   CHECK(cmdl[5] == "last");
+   CHECK(cmdl[6] == "@");
+
+   std::remove("argh_test_a.rsp");
+   std::remove("argh_test_b.rsp");
+}
+
+TEST_CASE("Test packed_parser stores positional args in one buffer")
+{
+   std::vector<std::string> args = { "app" };
+   for (int i = 0; i < 1000; ++i)
+      args.push_back("dir/file" + std::to_string(i) + ".txt");
+   args.push_back("-v");
+   args.push_back("last");
+   std::vector<const char*> argv;
+   for (auto& arg : args)
+      argv.push_back(arg.c_str());
+
+   packed_parser cmdl(static_cast<int>(argv.size()), argv.data());
+   REQUIRE(1002 == cmdl.size());
+   CHECK(cmdl["v"]);
+   size_t i = 0;
+   for (auto& arg : cmdl)
+   {
+      CHECK(arg == (i < 1001 ? args[i] : "last"));
+      CHECK('\0' == arg.data()[arg.size()]); // NUL-terminated in the buffer
+      ++i;
+   }
+   CHECK(1002 == i);
+   CHECK(cmdl[500] == "dir/file499.txt");
+   CHECK(cmdl[5000].empty());
+   CHECK(*cmdl.get<std::string>(1) == "dir/file0.txt");
+
+   // the 1000 strings mean a handful of buffer growths, not one allocation each
+   auto const before = allocation_count;
+   cmdl.reparse(static_cast<int>(argv.size()), argv.data());
+   CHECK(allocation_count - before <= 2); // the flag
+}
+
+TEST_CASE("Test get_cached converts each param once")
+{
+   const char* argv[] = { "app", "--threads=8", "--ratio", "0.5", "-v" };
+   parser cmdl({ "ratio" });
+   cmdl.parse(5, argv);
+
+   auto const& threads = cmdl.get_cached<int>("threads");
+   REQUIRE(threads);
+   CHECK(8 == *threads);
+   for (int i = 0; i < 10; ++i)
+   {
+      CHECK(&threads == &cmdl.get_cached<int>("threads"));  // the memoised value
+      CHECK(&threads == &cmdl.get_cached<int>("-threads")); // same name, same entry
+      CHECK(!cmdl.get_cached<int>("missing"));              // misses are memoised too
+      CHECK(cmdl.get_cached<int>("missing", 4) == 4);
+      CHECK(cmdl.get_cached<double>("ratio", 1.0) == 0.5);
+      CHECK(cmdl.get_cached<std::string>("ratio", "") == "0.5"); // per type
+   }
+
+   auto const before = allocation_count;
+   CHECK(cmdl.get_cached<std::string>("ratio", "") == "0.5");
+   CHECK(cmdl.get_cached<int>("threads", 0) == 8);
+   CHECK(allocation_count == before);
+
+   // a new parse drops the memoised values
+   const char* argv2[] = { "app", "--threads=2" };
+   cmdl.reparse(2, argv2);
+   CHECK(cmdl.get_cached<int>("threads", 0) == 2);
+   CHECK(!cmdl.get_cached<double>("ratio"));
+
+   // copies start with an empty cache
+   parser copy = cmdl;
+   CHECK(copy.get_cached<int>("threads", 0) == 2);
+   CHECK(&copy.get_cached<int>("threads") != &cmdl.get_cached<int>("threads"));
+}
+
+TEST_CASE("Test get_cached from concurrent readers")
+{
+   std::vector<std::string> args = { "app" };
+   for (int i = 0; i < 200; ++i)
+      args.push_back("--p" + std::to_string(i) + "=" + std::to_string(i));
+   std::vector<const char*> argv;
+   for (auto& arg : args)
+      argv.push_back(arg.c_str());
+   flat_parser const cmdl(static_cast<int>(argv.size()), argv.data());
+
+   std::vector<std::thread> readers;
+   std::vector<int> failures(8, 0);
+   for (size_t t = 0; t < failures.size(); ++t)
+      readers.emplace_back([&cmdl, &failures, t]
+      {
+         for (int round = 0; round < 20; ++round)
+            for (int i = 0; i < 200; ++i)
+               failures[t] += cmdl.get_cached<int>("p" + std::to_string(i), -1) != i;
+      });
+   for (auto& reader : readers)
+      reader.join();
+   for (auto failed : failures)
+      CHECK(0 == failed);
+}
+
+TEST_CASE_TEMPLATE("Test parsed_view snapshot", Parser, doctest::Types<parser, view_parser, flat_parser, packed_parser>)
+{
+   const char* argv[] = { "app", "-v", "-v", "--threads=8", "-o", "out", "in", "--zz" };
+   Parser cmdl({ "o" });
+   cmdl.parse(8, argv);
+
+   std::shared_ptr<parsed_view const> const view = make_parsed_view(cmdl);
+   cmdl.reset(); // the snapshot does not depend on the parser
+
+   auto const before = allocation_count;
+   CHECK(2 == view->size());
+   CHECK((*view)[0] == "app");
+   CHECK((*view)[1] == "in");
+   CHECK((*view)[2].empty());
+   CHECK((*view)["v"]);
+   CHECK((*view)["--zz"]);
+   CHECK(!(*view)["o"]);
+   CHECK(2 == view->count("-v"));
+   CHECK(*view->param("o") == "out");
+   CHECK(!view->param("zz"));
+   CHECK(*view->get<int>("threads") == 8);
+   CHECK(view->get<int>("missing", 3) == 3);
+   CHECK(!view->get<int>(1));
+   size_t n = 0;
+   for (auto& arg : *view)
+      n += arg.size();
+   CHECK(5 == n);
+   CHECK(allocation_count == before);
+
+   // copies are independent of the original buffers
+   parsed_view copy = *view;
+   CHECK(*copy.param("o") == "out");
+}
+
+TEST_CASE("Test parsed_view publishing")
+{
+   const char* argv1[] = { "app", "--level=1" };
+   const char* argv2[] = { "app", "--level=2" };
+   parser cmdl;
+   cmdl.parse(2, argv1);
+   auto current = make_parsed_view(cmdl);
+
+   std::atomic<bool> done(false);
+   std::vector<std::thread> readers;
+   std::atomic<int> bad(0);
+   for (int t = 0; t < 4; ++t)
+      readers.emplace_back([&]
+      {
+         while (!done)
+         {
+            auto view = std::atomic_load(&current);
+            auto level = view->get<int>("level", 0);
+            bad += level != 1 && level != 2;
+         }
+      });
+   for (int i = 0; i < 200; ++i)
+   {
+      cmdl.reparse(2, i % 2 ? argv1 : argv2);
+      std::atomic_store(&current, make_parsed_view(cmdl));
+   }
+   done = true;
+   for (auto& reader : readers)
+      reader.join();
+   CHECK(0 == bad);
+}
+
+TEST_CASE("Test classify matches the scalar rules")
+{
+   std::vector<std::string> args = { "-", "--", "---", "-a", "--abc", "-5", "-.5", "-1e", "-1e5", "--5", "-x=1", "--=", "a=b", "x", "- 1", "-inf",
+                                     std::string(40, '-'), std::string(17, '-') + "name", "--" + std::string(30, 'n') + "=" + std::string(20, 'v'),
+                                     "--" + std::string(16, 'n') + "=", "--" + std::string(15, 'n') + "=" };
+   for (auto& arg : args)
+   {
+      auto const info = parser_base::classify(arg);
+      CHECK(info.option() == (!parser_base::is_number(arg) && '-' == arg[0]));
+      auto const name = parser_base::trim_leading_dashes(arg);
+      CHECK(std::string(string_view(arg).substr(info.name)) == std::string(name));
+      if (info.option())
+      {
+         CHECK((parser_base::arg_info::ASSIGNMENT == info.kind ? info.equal : string_view::npos) == name.find('='));
+         auto const nosplit = parser_base::classify(arg, parser_base::NO_SPLIT_ON_EQUALSIGN).kind;
+         CHECK(nosplit == (1 == arg.size() - name.size() ? parser_base::arg_info::SHORT_OPTION : parser_base::arg_info::OPTION));
+      }
+   }
+}
+
+TEST_CASE("Test options across the classification blocks")
+{
+   // params whose value is the first arg of the next block of the side table
+   for (size_t lead : { 126u, 127u, 128u, 129u, 255u, 256u })
+   {
+      std::vector<std::string> args(lead, "pos");
+      for (int i = 0; i < 3; ++i)
+      {
+         args.push_back("-o");
+         args.push_back("value" + std::to_string(i));
+         args.push_back("--f" + std::to_string(i));
+      }
+      std::vector<const char*> argv;
+      for (auto& arg : args)
+         argv.push_back(arg.c_str());
+
+      parser cmdl({ "o" });
+      cmdl.parse(static_cast<int>(argv.size()), argv.data());
+      CHECK(lead == cmdl.size());
+      CHECK(cmdl("o").str() == "value0");
+      CHECK(3 == cmdl.flags().size());
+      CHECK(cmdl["f2"]);
+   }
+}
+
+TEST_CASE_TEMPLATE("Test multi-value params keep every value", Parser, doctest::Types<parser, view_parser, flat_parser, packed_parser>)
+{
+   const char* argv[] = { "app", "-I", "a", "--I=b", "-D", "x", "-I", "c", "-D", "y", "file" };
+   Parser cmdl;
+   cmdl.add_param("I", parser::MULTI_VALUE);
+   cmdl.add_param("-D");
+   cmdl.add_param("-A", parser::MULTI_VALUE); // registered before I, shifts its list
+   cmdl.parse(11, argv);
+
+   auto const& includes = cmdl.values("-I");
+   REQUIRE(3 == includes.size());
+   std::vector<std::string> got;
+   for (auto& dir : includes)
+      got.push_back(std::string(dir));
+   CHECK((got == std::vector<std::string>{ "a", "b", "c" }));
+   CHECK(cmdl("I").str() == "a");          // the first value
+   CHECK(cmdl("D").str() == "x");          // single value params keep the first value only
+   CHECK(cmdl.values("D").empty());
+   CHECK(cmdl.values("A").empty());
+   CHECK(cmdl.values("missing").empty());
+   CHECK(2 == cmdl.size());
+
+   const char* argv2[] = { "app", "-I", "z" };
+   cmdl.reparse(3, argv2);
+   CHECK(1 == cmdl.values("I").size());
+   CHECK(std::string(cmdl.values("I")[0]) == "z");
+}
+
+TEST_CASE("Test sub-command dispatch")
+{
+   command_parser cli({ "C" });
+   cli.add_command("build", { "j", "target" });
+   cli.add_command("push", { "remote" }).add_param("tag", parser::MULTI_VALUE);
+
+   const char* argv[] = { "tool", "-C", "dir", "-v", "build", "-j", "4", "--target", "all", "src", "-C", "x" };
+   cli.parse(12, argv);
+   REQUIRE(cli.command());
+   CHECK(cli.command_name() == "build");
+   CHECK(cli.global()("C").str() == "dir");
+   CHECK(cli.global()["v"]);
+   CHECK(1 == cli.global().size());
+   auto const& build = *cli.command();
+   CHECK(*build.get<int>("j") == 4);
+   CHECK(build("target").str() == "all");
+   CHECK(!build["v"]);
+   CHECK(build[1] == "src");
+   CHECK(build["C"]); // not registered for build: a flag, and x a positional
+   CHECK(3 == build.size());
+   CHECK(build[2] == "x");
+
+   // the same tables are reused for the next command line
+   const char* argv2[] = { "tool", "push", "--remote", "origin", "-tag", "a", "-tag", "b" };
+   cli.parse(8, argv2);
+   REQUIRE(cli.command());
+   CHECK(cli.command_name() == "push");
+   CHECK(cli.command()->operator()("remote").str() == "origin");
+   CHECK(2 == cli.command()->values("tag").size());
+   CHECK(!cli.global()("C"));
+
+   // no or unknown command
+   const char* argv3[] = { "tool", "-v", "nope", "build" };
+   cli.parse(4, argv3);
+   CHECK(!cli.command());
+   CHECK(cli.command_name().empty());
+   CHECK(3 == cli.global().size());
+}
+
+TEST_CASE("Test registering params one at a time keeps them sorted")
+{
+   parser cmdl;
+   for (int i = 199; i >= 0; --i)
+   {
+      cmdl.add_param("p" + std::to_string(i * 7 % 200), i % 3 ? parser::SINGLE_VALUE : parser::MULTI_VALUE);
+      cmdl.add_params({ "--p0" });                           // already registered
+      cmdl.add_param({ ("a" + std::to_string(i)).c_str(), ("b" + std::to_string(i)).c_str() });
+   }
+   auto const& names = cmdl.registered_params();
+   CHECK(600 == names.size());                               // p*, a* and the b* aliases, once each
+   CHECK(std::is_sorted(names.begin(), names.end()));
+   CHECK(names.end() == std::adjacent_find(names.begin(), names.end()));
+
+   const char* argv[] = { "app", "--p7", "x", "-b42", "y", "--p0", "1", "--p0", "2" };
+   cmdl.parse(9, argv);
+   CHECK(cmdl("p7").str() == "x");
+   CHECK(cmdl("a42").str() == "y");
+   CHECK(2 == cmdl.values("p0").size());                     // i = 0 registered it MULTI_VALUE
+}
+
+TEST_CASE_TEMPLATE("Test param aliases are canonicalised during parse", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   Parser cmdl;
+   cmdl.add_param({ "o", "--output", "-out-file" });
+   cmdl.add_param({ "I", "include" }, parser::MULTI_VALUE);
+
+   const char* argv[] = { "app", "--output", "a.out", "-o", "b.out", "-I", "x", "--include=y", "--out-file" };
+   cmdl.parse(9, argv);
+   CHECK(2 == cmdl.params().size());                  // o and I, under their first names
+   CHECK(cmdl("o").str() == "a.out");                  // the first value, given as --output
+   CHECK(cmdl("out-file").str() == "a.out");
+   CHECK(cmdl({ "-o", "--output", "--out-file" }).str() == "a.out");
+   CHECK(*cmdl.template get<std::string>({ "--nope", "output" }) == "a.out");
+   CHECK(2 == cmdl.values("include").size());
+   CHECK(cmdl["o"]);                                  // the trailing --out-file is a flag, as o
+   CHECK(cmdl[{ "output" }]);
+   CHECK(cmdl["out-file"]);
+   CHECK(1 == cmdl.flags().size());
+   CHECK(1 == cmdl.size());
+
+   auto const before = allocation_count;
+   CHECK(cmdl.template get<string_view>({ "-o", "--output", "--out-file" })->size() == 5);
+   CHECK(allocation_count == before);
+}
+
+TEST_CASE_TEMPLATE("Test aliased names of a view parser survive copies and later registrations", Parser, doctest::Types<view_parser, flat_view_parser>)
+{
+   std::unique_ptr<Parser> cmdl(new Parser);
+   cmdl->add_param({ "output-file-name-long-enough", "o" });
+   cmdl->add_param({ "verbose-flag-name-long-enough", "v", "V" });
+   const char* argv[] = { "app", "-o", "x", "-v" };
+   cmdl->parse(4, argv);
+   for (int i = 0; i < 100; ++i)
+      cmdl->add_param({ ("param-" + std::to_string(i)).c_str(), ("p" + std::to_string(i)).c_str() });
+
+   Parser copy(*cmdl);
+   cmdl.reset();
+   CHECK(copy("output-file-name-long-enough").str() == "x");
+   CHECK(copy("o").str() == "x");
+   CHECK(copy["verbose-flag-name-long-enough"]);
+   CHECK(copy["V"]);
+   CHECK(copy.params().begin()->first == "output-file-name-long-enough");
+   CHECK(*copy.flags().begin() == "verbose-flag-name-long-enough");
+}
+
+TEST_CASE_TEMPLATE("Test single char flags are counted apart from flags()", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   const char* argv[] = { "app", "-xvzf", "--v", "-\xe9", "--verbose", "-vw" };
+   Parser cmdl;
+   cmdl.parse(6, argv, parser::SINGLE_DASH_IS_MULTIFLAG);
+
+   auto const before = allocation_count;
+   CHECK(cmdl["v"]);
+   CHECK(cmdl["-x"]);
+   CHECK(cmdl["\xe9"]);
+   CHECK(!cmdl["y"]);
+   CHECK(cmdl[{ "y", "w" }]);
+   CHECK(cmdl["verbose"]);
+   CHECK(allocation_count == before);
+
+   // flags() is the same sorted multiset as when each char is stored
+   std::vector<std::string> expected = { "f", "v", "v", "v", "verbose", "w", "x", "z", "\xe9" };
+   auto& flags = cmdl.flags();
+   REQUIRE(expected.size() == flags.size());
+   CHECK(std::equal(expected.begin(), expected.end(), flags.begin(), [](std::string const& a, string_view b) { return a == b; }));
+   CHECK(3 == flags.count("v"));
+
+   // parse() after flags() adds to both
+   const char* more[] = { "-v", "-y" };
+   cmdl.parse(2, more, parser::SINGLE_DASH_IS_MULTIFLAG);
+   CHECK(cmdl["y"]);
+   CHECK(11 == cmdl.flags().size());
+
+   cmdl.reset();
+   CHECK(!cmdl["v"]);
+   CHECK(cmdl.flags().empty());
+   cmdl.parse(2, more);
+   CHECK(cmdl["v"]);
+   CHECK(2 == cmdl.flags().size());
+}
+
+TEST_CASE_TEMPLATE("Test count() of repeated flags", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   const char* argv[] = { "app", "-v", "--verbose", "-vv", "--verbose", "-v", "pos", "--quiet", "--verbose", "-v" };
+   Parser cmdl;
+   cmdl.parse(10, argv, parser::SINGLE_DASH_IS_MULTIFLAG);
+
+   auto const before = allocation_count;
+   CHECK(5 == cmdl.count("v"));
+   CHECK(5 == cmdl.count("-v"));
+   CHECK(3 == cmdl.count("--verbose"));
+   CHECK(1 == cmdl.count("quiet"));
+   CHECK(0 == cmdl.count("q"));
+   CHECK(0 == cmdl.count("missing"));
+   CHECK(allocation_count == before);
+
+   CHECK(9 == cmdl.flags().size());
+   CHECK(3 == cmdl.flags().count("verbose"));
+
+   // counts add up over parse() calls, reset() zeroes them
+   const char* more[] = { "--verbose", "-v" };
+   cmdl.parse(2, more);
+   CHECK(6 == cmdl.count("v"));
+   CHECK(4 == cmdl.count("verbose"));
+   CHECK(11 == cmdl.flags().size());
+   cmdl.reset();
+   CHECK(0 == cmdl.count("verbose"));
+   CHECK(!cmdl["verbose"]);
+}
+
+TEST_CASE_TEMPLATE("Test lazy_parser parses on first access", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   const char* argv[] = { "app", "-v", "--out", "a.txt", "pos1", "--dry-run", "-n", "3", "pos2", "-v", nullptr };
+   SUBCASE("named accessors stop once the name is found")
+   {
+      basic_lazy_parser<Parser> cmdl(argv);
+      cmdl.add_params({ "out", "n" });
+      CHECK(cmdl["v"]);
+      CHECK(cmdl("out").str() == "a.txt");
+      CHECK(cmdl["dry-run"]);
+      CHECK(!cmdl.parsed());
+      CHECK(!cmdl->flags().empty());  // parses the rest
+      CHECK(cmdl.parsed());
+      CHECK(2 == cmdl->count("v"));
+      CHECK(3 == *cmdl.template get<int>("n"));
+      CHECK(!cmdl["missing"]);
+      CHECK(7 == cmdl.template get<int>("missing", 7));
+   }
+   SUBCASE("a missing name parses to the end")
+   {
+      basic_lazy_parser<Parser> cmdl(10, argv);
+      cmdl.add_params({ "out", "n" });
+      CHECK(!cmdl["missing"]);
+      CHECK(3 == cmdl.size());
+      CHECK(cmdl[2] == "pos2");
+   }
+   SUBCASE("same results as parse()")
+   {
+      for (int mode : std::initializer_list<int>{ parser::PREFER_FLAG_FOR_UNREG_OPTION, parser::PREFER_PARAM_FOR_UNREG_OPTION, parser::SINGLE_DASH_IS_MULTIFLAG })
+      {
+         Parser eager(argv, mode);
+         basic_lazy_parser<Parser> cmdl(argv, mode);
+         CHECK(cmdl("out").str() == eager("out").str());
+         CHECK(cmdl("dry-run").str() == eager("dry-run").str());
+         CHECK(cmdl["v"] == eager["v"]);
+         REQUIRE(cmdl.size() == eager.size());
+         CHECK(std::equal(eager.begin(), eager.end(), cmdl.begin(), [](string_view a, string_view b) { return a == b; }));
+         CHECK(cmdl->params().size() == eager.params().size());
+         CHECK(cmdl->flags().size() == eager.flags().size());
+      }
+   }
+}
+
+namespace
+{
+   void set_env(char const* name, char const* value) // nullptr to remove
+   {
+#if defined(_WIN32)
+      _putenv_s(name, value ? value : "");
+#else
+      if (value)
+         ::setenv(name, value, 1);
+      else
+         ::unsetenv(name);
+#endif
+   }
+}
+
+TEST_CASE_TEMPLATE("Test env and config layers under the command line", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   {
+      std::ofstream config("argh_test.conf");
+      config << "# defaults\n"
+                "threads = 2\n"
+                "output=from-config\r\n"
+                "  --mode = fast  \n"
+                "no equal sign\n"
+                "=no key\n"
+                "include=conf-dir\n";
+   }
+   set_env("ARGH_TEST_OUTPUT", "from-env");
+   set_env("ARGH_TEST_LOG_LEVEL", "3");
+   set_env("ARGH_TEST_INCLUDE", "env-dir");
+
+   Parser cmdl;
+   cmdl.add_params({ "output", "log-level", "threads", "mode" });
+   cmdl.add_param({ "I", "include" }, parser::MULTI_VALUE);
+   cmdl.set_env_prefix("ARGH_TEST_");
+   REQUIRE(cmdl.set_config_file("argh_test.conf"));
+   CHECK(!cmdl.set_config_file("argh_test_missing.conf"));
+
+   const char* argv[] = { "app", "--threads", "8", "-I", "cli-dir" };
+   cmdl.parse(5, argv);
+   CHECK(cmdl("threads").str() == "8");            // command line
+   CHECK(cmdl("output").str() == "from-env");       // env beats config
+   CHECK(3 == *cmdl.template get<int>("log-level")); // env only
+   CHECK(cmdl("mode").str() == "fast");             // config only, trimmed
+   CHECK(1 == cmdl.values("I").size());             // the command line had values
+   CHECK(cmdl.values("I")[0] == "cli-dir");
+   CHECK(5 == cmdl.params().size());
+
+   const char* bare[] = { "app" };
+   cmdl.reparse(1, bare);
+   CHECK(cmdl("threads").str() == "2");
+   CHECK(1 == cmdl.values("include").size());
+   CHECK(cmdl.values("include")[0] == "env-dir");
+
+   // a lazy parser merges the layers once the whole command line is parsed
+   const char* output[] = { "app", "--output", "cli", "-v", nullptr };
+   basic_lazy_parser<Parser> lazy(output);
+   lazy.add_params({ "output", "threads" });
+   lazy.set_env_prefix("ARGH_TEST_");
+   REQUIRE(lazy.set_config_file("argh_test.conf"));
+   CHECK(lazy("output").str() == "cli");
+   CHECK(!lazy.parsed());
+   CHECK(lazy("threads").str() == "2");
+
+   set_env("ARGH_TEST_OUTPUT", nullptr);
+   set_env("ARGH_TEST_LOG_LEVEL", nullptr);
+   set_env("ARGH_TEST_INCLUDE", nullptr);
+   std::remove("argh_test.conf");
+}
+
+TEST_CASE_TEMPLATE("Test env layer names of a view parser survive copies and later registrations", Parser, doctest::Types<view_parser, flat_view_parser>)
+{
+   set_env("ARGH_TEST_LOG_LEVEL", "3");
+   std::unique_ptr<Parser> cmdl(new Parser);
+   cmdl->add_params({ "log-level" });
+   cmdl->set_env_prefix("ARGH_TEST_");
+   const char* argv[] = { "app" };
+   cmdl->parse(1, argv);
+   for (int i = 0; i < 100; ++i)
+      cmdl->add_param("param-" + std::to_string(i));
+   set_env("ARGH_TEST_LOG_LEVEL", "a different value, long enough to need a new buffer");
+
+   Parser copy(*cmdl);
+   cmdl.reset();
+   CHECK(copy.params().size() == 1);
+   CHECK(copy.params().begin()->first == "log-level");
+   CHECK(copy("log-level").str() == "3");
+   set_env("ARGH_TEST_LOG_LEVEL", nullptr);
+}
+
+TEST_CASE_TEMPLATE("Test replacing the config file after a parse", Parser, doctest::Types<parser, view_parser, flat_view_parser>)
+{
+   std::ofstream("argh_test_a.conf") << "threads = 2\n";
+   std::ofstream("argh_test_b.conf") << "threads = 8\nlevel = 1\n";
+   const char* argv[] = { "app" };
+   Parser cmdl;
+   cmdl.add_params({ "threads", "level" });
+   REQUIRE(cmdl.set_config_file("argh_test_a.conf"));
+   cmdl.parse(1, argv);
+   REQUIRE(cmdl.set_config_file("argh_test_b.conf"));
+   CHECK(cmdl("threads").str() == "2"); // the merged values refer to the first file, which is kept
+   cmdl.parse(1, argv);
+   CHECK(cmdl("threads").str() == "2"); // merged first, like a repeated param
+   CHECK(cmdl("level").str() == "1");   // the new file is merged too
+   cmdl.reparse(1, argv);
+   CHECK(cmdl("threads").str() == "8");
+   std::remove("argh_test_a.conf");
+   std::remove("argh_test_b.conf");
+}
+
+TEST_CASE_TEMPLATE("Test to_blob and parsed_blob round trip", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   const char* argv[] = { "app", "-v", "--out", "a.txt", "pos", "--level=3", "-v", "--empty=", "" };
+   Parser cmdl({ "out" });
+   cmdl.parse(9, argv);
+   auto const blob = to_blob(cmdl);
+   CHECK(0 == blob.size() % 4);
+
+   parsed_blob loaded;
+   REQUIRE(loaded.load(blob.data(), blob.size()));
+   parsed_view const view(cmdl);
+   REQUIRE(view.size() == loaded.size());
+   CHECK(std::equal(view.begin(), view.end(), loaded.begin()));
+   CHECK(2 == loaded.count("v"));
+   CHECK(loaded["-v"]);
+   CHECK(!loaded["out"]);
+   CHECK(*loaded.param("out") == "a.txt");
+   CHECK(3 == *loaded.get<int>("level"));
+   CHECK(loaded.param("empty")->empty());
+   CHECK(!loaded.param("missing"));
+   CHECK(loaded[3].empty());
+   REQUIRE(1 == loaded.registered_params().size());
+   CHECK(loaded.registered_params()[0] == "out");
+
+   // through a cache file, mapped and served in place
+   auto const key = argv_hash(9, argv);
+   const char* other[] = { "app", "-v", "--out", "a.txtpos" };
+   CHECK(key != argv_hash(4, other));
+   std::string const path = "argh_test_" + std::to_string(key % 1000) + ".blob";
+   std::ofstream(path, std::ios::binary) << blob;
+   {
+      mapped_file file(path.c_str());
+      REQUIRE(file.is_open());
+      parsed_blob cached;
+      REQUIRE(cached.load(file.data(), file.size()));
+      CHECK(*cached.param("--out") == "a.txt");
+      CHECK(cached[1] == "pos");
+   }
+   std::remove(path.c_str());
+}
+
+TEST_CASE_TEMPLATE("Test parsed views, blobs and batch results resolve aliases", Parser, doctest::Types<parser, view_parser, flat_view_parser>)
+{
+   const char* argv[] = { "app", "-o", "x", "--verbose", "-v" };
+   Parser cmdl;
+   cmdl.add_param({ "o", "output" });
+   cmdl.add_option(argh::flag("verbose", "v"));
+   cmdl.parse(5, argv);
+
+   auto const view = make_parsed_view(cmdl);
+   CHECK(*view->param("o") == "x");
+   CHECK(*view->param("--output") == "x");
+   CHECK(2 == view->count("v"));
+   CHECK(2 == view->count("verbose"));
+
+   auto const blob = to_blob(cmdl);
+   parsed_blob loaded;
+   REQUIRE(loaded.load(blob.data(), blob.size()));
+   CHECK(*loaded.param("output") == "x");
+   CHECK(*loaded.param("o") == "x");
+   CHECK(2 == loaded.count("-v"));
+
+   const char* argv2[] = { "app", "--output", "y", "-v" };
+   std::vector<argv_span> lines = { { 5, argv }, { 4, argv2 } };
+   auto results = parse_batch(lines.begin(), lines.end(), cmdl.registered_params(), cmdl.aliases());
+   cmdl.add_param("late"); // the results keep their own copy of the names
+   REQUIRE(2 == results.size());
+   CHECK(results.param(0, "output").value_or("") == "x");
+   CHECK(results.param(1, "o").value_or("") == "y");
+   CHECK(results.flag(0, "verbose"));
+   CHECK(results.flag(1, "verbose"));
+}
+
+TEST_CASE("Test parsed_blob rejects invalid blobs")
+{
+   const char* argv[] = { "app", "-v", "--out=a.txt", "pos" };
+   parser cmdl(4, argv);
+   auto const blob = to_blob(cmdl);
+
+   parsed_blob loaded;
+   REQUIRE(loaded.load(blob.data(), blob.size()));
+   for (size_t size = 0; size < blob.size(); ++size)
+      CHECK(!loaded.load(blob.data(), size));     // truncated
+   CHECK(*loaded.param("out") == "a.txt");        // the previous blob is kept
+
+   std::vector<std::uint32_t> aligned(blob.size() / 4 + 2);
+   auto const bytes = reinterpret_cast<char*>(aligned.data());
+   std::memcpy(bytes + 1, blob.data(), blob.size());
+   CHECK(!loaded.load(bytes + 1, blob.size()));   // misaligned
+
+   std::memcpy(bytes, blob.data(), blob.size());
+   REQUIRE(loaded.load(bytes, blob.size()));
+   bytes[4] = 9;                                  // version
+   CHECK(!loaded.load(bytes, blob.size()));
+   std::memcpy(bytes, blob.data(), blob.size());
+   bytes[blob.size() - 4] = bytes[blob.size() - 3] = bytes[blob.size() - 2] = bytes[blob.size() - 1] = 'x'; // chars without NUL
+   CHECK(!loaded.load(bytes, blob.size()));
+}
+
+TEST_CASE_TEMPLATE("Test parse takes over a vector of strings", Parser, doctest::Types<parser, view_parser, flat_parser, flat_view_parser, packed_parser>)
+{
+   std::string const long_pos = "a positional arg too long for the small string buffer";
+   std::string const long_value = "a param value too long for the small string buffer";
+   auto make_args = [&] { return std::vector<std::string>{ "app", long_pos, "--out", long_value, "--level=3", "-v", "-I", "x", "-I", "y", "tail" }; };
+
+   Parser cmdl({ "out" });
+   cmdl.add_param("I", parser::MULTI_VALUE);
+   {
+      auto args = make_args();
+      cmdl.parse(std::move(args));
+   }
+   CHECK(cmdl[1] == long_pos);
+   CHECK(cmdl[2] == "tail");
+   CHECK(cmdl("out").str() == long_value);
+   CHECK(3 == *cmdl.template get<int>("level"));
+   CHECK(cmdl["v"]);
+   REQUIRE(2 == cmdl.values("I").size());
+   CHECK(cmdl.values("I")[1] == "y");
+
+   // the same results as parsing an argv of the same args
+   auto const args = make_args();
+   std::vector<const char*> argv;
+   for (auto& arg : args)
+      argv.push_back(arg.c_str());
+   Parser reference({ "out" });
+   reference.add_param("I", parser::MULTI_VALUE);
+   reference.parse(static_cast<int>(argv.size()), argv.data());
+   CHECK(reference.size() == cmdl.size());
+   CHECK(reference.params().size() == cmdl.params().size());
+   CHECK(reference.flags().size() == cmdl.flags().size());
+
+   // a copy keeps the results valid after the original is gone
+   auto copy = std::unique_ptr<Parser>(new Parser(cmdl));
+   cmdl.reset();
+   CHECK((*copy)[1] == long_pos);
+   CHECK((*copy)("out").str() == long_value);
+}
+
+TEST_CASE("Test parse moves whole args into a parser")
+{
+   std::vector<std::string> args = { "app", "a positional arg too long for the small string buffer",
+                                     "--out", "a param value too long for the small string buffer", "--level=a value after an equal sign, sliced" };
+   auto const pos = args[1].data();
+   auto const value = args[3].data();
+   parser cmdl({ "out" });
+   cmdl.parse(std::move(args));
+   CHECK(cmdl[1].data() == pos);          // moved, not copied
+   CHECK(cmdl.params().find("out")->second.data() == value);
+   CHECK(cmdl("level").str() == "a value after an equal sign, sliced");
+}
+
+TEST_CASE("Test floating point conversion edge cases are the same in every standard")
+{
+   auto convert = [](const char* str, double& value) { return from_chars(str, str + std::strlen(str), value); };
+   double value = 7;
+   CHECK(convert("+1.5", value));
+   CHECK(value == 1.5);
+   CHECK(convert("0x1p3", value));
+   CHECK(value == 8);
+   CHECK(convert("1e-400", value));       // underflows to 0
+   CHECK(value == 0);
+   CHECK(convert("4e-320", value));       // subnormal
+   CHECK(value == 4e-320);
+   CHECK(convert("-1e-310", value));
+   CHECK(value == -1e-310);
+   float single = 0;
+   CHECK(from_chars("1e-40", "1e-40" + 5, single));
+   CHECK(single == 1e-40f);
+   value = 7;
+   CHECK(!convert("1e400", value));       // overflows
+   CHECK(!convert("-1e400", value));
+   CHECK(!from_chars("1e39", "1e39" + 4, single));
+   CHECK(!convert("1.5x", value));
+   CHECK(!convert(" 1.5", value));
+   CHECK(value == 7);                     // untouched on failure
+   CHECK(convert("-inf", value));
+   CHECK(value == -std::numeric_limits<double>::infinity());
+
+   // the same as operator>>
+   const char* argv[] = { "app", "--tiny=1e-310", "--huge=1e400" };
+   parser cmdl(3, argv);
+   double streamed = 0;
+   CHECK(!(cmdl("tiny") >> streamed).fail());
+   CHECK(*cmdl.get<double>("tiny") == streamed);
+   CHECK((cmdl("huge") >> streamed).fail());
+   CHECK(!cmdl.get<double>("huge"));
+}
+
+#if defined(ARGH_CPP17)
+TEST_CASE("Test C++17 std::string_view and std::optional interop")
+{
+   const char* argv[] = { "app", "--name=argh", "-v", "pos" };
+   int argc = sizeof(argv) / sizeof(argv[0]);
+   parser cmdl(argc, argv);
+
+   std::string_view const name = "name";
+   CHECK(cmdl(name).str() == "argh");    // std::string_view converts to the argh one
+   CHECK(cmdl[std::string_view("v")]);
+   CHECK(cmdl.count(std::string_view("v")) == 1);
+   CHECK(std::string_view(string_view(cmdl[1])) == "pos");
+
+   CHECK(*cmdl.get<std::string_view>("name") == "argh");
+   std::optional<int> const missing = cmdl.get<int>("threads");
+   CHECK(!missing);
+   std::optional<std::string_view> const value = cmdl.get<std::string_view>("name");
+   CHECK(value == "argh");
+}
+#endif
+
+// the container types do not depend on the language standard
+static_assert(std::is_same<parser::param_map, std::map<std::string, std::string>>::value, "std::map params");
+static_assert(std::is_same<parser::flag_set, std::multiset<std::string>>::value, "std::multiset flags");
+
+TEST_CASE("Test tree storage lookups of long names reuse a per-thread key")
+{
+   std::string const name = "a-param-name-too-long-for-the-small-string-buffer";
+   auto const option = "--" + name;
+   const char* argv[] = { "app", option.c_str(), "x" };
+   parser cmdl({ name.c_str() });
+   cmdl.parse(3, argv);
+   std::map<std::string, std::string> const& params = cmdl.params();
+   CHECK(params.size() == 1);
+
+   CHECK(cmdl.get<string_view>(name)->size() == 1); // sizes the per-thread key
+   auto const before = allocation_count;
+   CHECK(cmdl.get<string_view>(name)->size() == 1);
+   CHECK(cmdl.count(name) == 0);
+   CHECK(allocation_count == before);
+}
+
+constexpr auto help_schema = make_schema(argh::param("threads", "j").with_type("N").with_default("1").with_help("worker threads"),
+                                         argh::flag("verbose", "v").with_help("print more"),
+                                         argh::param("--out"),
+                                         argh::flag("-x").with_default("off"));
+
+TEST_CASE("Test help and completion rendering")
+{
+   auto const help = help_schema.help();
+   CHECK(help ==
+         "  -j, --threads N  worker threads (default: 1)\n"
+         "  -v, --verbose    print more\n"
+         "  --out VALUE\n"
+         "  -x               (default: off)\n");
+   CHECK(help.size() == help_size(help_schema));
+   CHECK(help_schema.help(COMPLETION_WORDS) == "-j --threads -v --verbose --out -x\n");
+   CHECK(help_string(nullptr, nullptr).empty());
+
+   // a fixed buffer of the exact size holds the same text, a smaller one truncates
+#if defined(ARGH_CPP17)
+   constexpr auto fixed = static_help<help_size(help_schema)>(help_schema);
+#else
+   auto const fixed = static_help<125>(help_schema);
+#endif
+   CHECK(string_view(fixed) == help);
+   CHECK(std::strlen(fixed.c_str()) == fixed.size());
+   CHECK(string_view(static_help<4>(help_schema, COMPLETION_WORDS)) == "-j -");
+}
+
+TEST_CASE("Test add_option registers params and renders their help")
+{
+   parser cmdl;
+   cmdl.add_option(argh::param("threads", "j").with_type("N").with_default("1").with_help("worker threads"));
+   cmdl.add_option(argh::flag("verbose", "v").with_help("print more"));
+   cmdl.add_option(argh::param("--out"));
+   cmdl.add_option(argh::flag("-x").with_default("off"));
+   CHECK(cmdl.help() == help_schema.help());
+   CHECK(cmdl.help(COMPLETION_WORDS) == help_schema.help(COMPLETION_WORDS));
+
+   const char* argv[] = { "app", "-j", "4", "--out", "file", "-v", "pos" };
+   cmdl.parse(sizeof(argv) / sizeof(argv[0]), argv);
+   CHECK(cmdl("threads").str() == "4");   // the alias was registered
+   CHECK(cmdl("out").str() == "file");
+   CHECK(cmdl["verbose"]);                // flag aliases are linked too
+   CHECK(cmdl["v"]);
+   CHECK(1 == cmdl.count("verbose"));
+   CHECK(0 == cmdl.registered_params().count("v")); // not a param
+   CHECK(cmdl[1] == "pos");
+
+   flat_view_parser multi;
+   multi.add_option(argh::flag("x", "extract"));
+   const char* flags[] = { "app", "-vx", "--extract" };
+   multi.parse(3, flags, parser::SINGLE_DASH_IS_MULTIFLAG);
+   CHECK(2 == multi.count("x"));
+   CHECK(2 == multi.count("--extract"));
+
+   lazy_parser lazy(sizeof(argv) / sizeof(argv[0]), argv);
+   lazy.add_option(argh::param("j"));
+   CHECK(lazy.help() == "  -j VALUE\n");
+   CHECK(lazy("j").str() == "4");
+}
+
+#if defined(ARGH_CPP17)
+// rendered while compiling
+constexpr auto static_words = static_help<help_size(help_schema, COMPLETION_WORDS)>(help_schema, COMPLETION_WORDS);
+static_assert(static_words.size() == 35 && static_words.chars[1] == 'j' && static_words.chars[34] == '\n', "compile-time completion words");
+#endif
@@ -4284,6 +4284,9 @@ namespace detail
 #if defined(_MSC_VER)
 #pragma warning(push)
 #pragma warning(disable : 4996) // std::uncaught_exception is deprecated in C++17
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 #endif
     void useContextIfExceptionOccurred(IContextScope* ptr) {
         if(std::uncaught_exception()) {
@@ -4294,6 +4297,8 @@ namespace detail
     }
 #if defined(_MSC_VER)
 #pragma warning(pop)
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
 #endif
 
     void printSummary();
@@ -4400,7 +4405,7 @@ namespace detail
         static bool             isSet;
         static struct sigaction oldSigActions[sizeof(signalDefs) / sizeof(SignalDefs)];
         static stack_t          oldSigStack;
-        static char             altStackMem[SIGSTKSZ];
+        static char             altStackMem[4 * 8192]; // SIGSTKSZ is not a constant on newer glibc
 
         static void handleSignal(int sig) {
             std::string name = "<unknown signal>";
@@ -4420,7 +4425,7 @@ namespace detail
             isSet = true;
             stack_t sigStack;
             sigStack.ss_sp    = altStackMem;
-            sigStack.ss_size  = SIGSTKSZ;
+            sigStack.ss_size  = sizeof(altStackMem);
             sigStack.ss_flags = 0;
             sigaltstack(&sigStack, &oldSigStack);
             struct sigaction sa = {0};
@@ -4450,7 +4455,7 @@ namespace detail
     struct sigaction FatalConditionHandler::oldSigActions[sizeof(signalDefs) / sizeof(SignalDefs)] =
             {};
     stack_t FatalConditionHandler::oldSigStack           = {};
-    char    FatalConditionHandler::altStackMem[SIGSTKSZ] = {};
+    char    FatalConditionHandler::altStackMem[4 * 8192] = {};
 
 #endif // DOCTEST_PLATFORM_WINDOWS
 #endif // DOCTEST_CONFIG_POSIX_SIGNALS || DOCTEST_CONFIG_WINDOWS_SEH